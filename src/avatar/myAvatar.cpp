@@ -21,9 +21,11 @@
 #include "utils/helpers.hpp"
 #include <avatar/myAvatar.hpp>
 #include <tracker/CLM.hpp>
+#include <tracker/ThreadPool.hpp>
 #include <opencv2/highgui/highgui.hpp>
 #define it at<int>
 #define db at<double>
+#define PDM_ITER 10 //CalcParams cap when warm started from the last frame
 using namespace AVATAR;
 using namespace std;
 //=============================================================================
@@ -89,9 +91,9 @@ void myAvatar::Read(ifstream &s,bool readType)
   _warp.Read(s); _pdm.Read(s); _gpdm.Read(s); _gen.Read(s);  _expr.resize(k);
   for(int i = 0; i < k; i++)FACETRACKER::IO::ReadMat(s,_expr[i]);
   _user.create(3*_pdm.nPoints(),1,CV_64F);
-  plocal_.create(_pdm.nModes(),1,CV_64F);
+  plocal_.create(_pdm.nModes(),1,CV_64F); plocal_ = cv::Scalar(0);
   pglobl_.create(6,1,CV_64F);
-  gplocal_.create(_gpdm.nModes(),1,CV_64F);
+  gplocal_.create(_gpdm.nModes(),1,CV_64F); gplocal_ = cv::Scalar(0);
   gpglobl_.create(6,1,CV_64F);
   _shape.create(2*_pdm.nPoints(),1,CV_64F);
   textr_.create(3*_warp._nPix,1,CV_64F);
@@ -165,9 +167,9 @@ void myAvatar::ReadBinary(ifstream &s,bool readType)
     FACETRACKER::IOBinary::ReadMat(s,_expr[i]);
   
   _user.create(3*_pdm.nPoints(),1,CV_64F);
-  plocal_.create(_pdm.nModes(),1,CV_64F);
+  plocal_.create(_pdm.nModes(),1,CV_64F); plocal_ = cv::Scalar(0);
   pglobl_.create(6,1,CV_64F);
-  gplocal_.create(_gpdm.nModes(),1,CV_64F);
+  gplocal_.create(_gpdm.nModes(),1,CV_64F); gplocal_ = cv::Scalar(0);
   gpglobl_.create(6,1,CV_64F);
   _shape.create(2*_pdm.nPoints(),1,CV_64F);
   textr_.create(3*_warp._nPix,1,CV_64F);
@@ -294,7 +296,7 @@ myAvatar::Animate(cv::Mat &draw,
   if(p->avatar_shape){
     if(p->animate_rigid && p->animate_exprs)_shape=this->AnimateShape(shape,1);
     else if(p->animate_rigid && !p->animate_exprs){
-      _user.copyTo(_pdm._M); _pdm.CalcParams(shape,plocal_,pglobl_);
+      _user.copyTo(_pdm._M); _pdm.CalcParams(shape,plocal_,pglobl_,PDM_ITER);
       _shapes[_idx].copyTo(_pdm._M); p_ = cv::Scalar(0);
       _pdm.CalcShape2D(_shape,p_,pglobl_);
     }
@@ -345,7 +347,7 @@ myAvatar::Animate(cv::Mat &draw,
     lp.x = _lpupil[_idx].px + dx*wl; lp.y = _lpupil[_idx].py + dy*hl;
     rp.x = _rpupil[_idx].px + dx*wr; rp.y = _rpupil[_idx].py + dy*hr;
     this->WarpBackPupils(lp,rp,_shapes[_idx],_shape);
-    _gpdm.CalcParams(shape,gplocal_,gpglobl_);
+    _gpdm.CalcParams(shape,gplocal_,gpglobl_,PDM_ITER);
     lrad = _lpupil[_idx].rad*gpglobl_.db(0,0);
     rrad = _rpupil[_idx].rad*gpglobl_.db(0,0);
 
@@ -398,8 +400,9 @@ myAvatar::AnimateShape(cv::Mat &shape,
 		       int scale_eyes)
 {
   //sanity check
-  if((plocal_.rows != _pdm.nModes()) || (plocal_.cols != 1))
-    plocal_.create(_pdm.nModes(),1,CV_64F);
+  if((plocal_.rows != _pdm.nModes()) || (plocal_.cols != 1)){
+    plocal_.create(_pdm.nModes(),1,CV_64F); plocal_ = cv::Scalar(0);
+  }
   if((pglobl_.rows != 6) || (pglobl_.cols != 1))pglobl_.create(6,1,CV_64F);
   if((_shape.rows != 2*_pdm.nPoints()) || (_shape.cols != 1))
     _shape.create(2*_pdm.nPoints(),1,CV_64F);
@@ -410,7 +413,7 @@ myAvatar::AnimateShape(cv::Mat &shape,
   
   //calculate user parameters
   _user.copyTo(_pdm._M);
-  _pdm.CalcParams(shape,plocal_,pglobl_);
+  _pdm.CalcParams(shape,plocal_,pglobl_,PDM_ITER);
 
   //map parameters to avatar
   p_ = _reg[_idx]*plocal_;
@@ -440,12 +443,61 @@ myAvatar::AnimateShape(cv::Mat &shape,
   _pdm.CalcShape2D(_shape,p_,pglobl_); return _shape;
 }
 //=============================================================================
+//piecewise affine warp of each triangle of the mesh
+struct WarpBody : public FACETRACKER::ParallelBody{
+  cv::Mat &src_pts,&dst_pts,&tri; vector<cv::Mat> &src_img,&dst_img;
+  WarpBody(cv::Mat &sp,cv::Mat &dp,cv::Mat &t,vector<cv::Mat> &si,
+	   vector<cv::Mat> &di)
+    : src_pts(sp),dst_pts(dp),tri(t),src_img(si),dst_img(di){;}
+  void operator()(int begin,int end){
+    int n = src_pts.rows/2,c = src_img.size();
+    for(int l = begin; l < end; l++){
+      int i,j,k,xmin,ymin,xmax,ymax;
+      double dx[3],dy[3],sx[3],sy[3],x,y;
+      cv::Mat A(2,3,CV_64F),Xi(3,3,CV_64F),X(3,3,CV_64F),Y(3,2,CV_64F);
+      for(i = 0; i < 3; i++){
+	j = tri.it(l,i);
+	sx[i] = src_pts.db(j,0); sy[i] = src_pts.db(j+n,0);
+	dx[i] = dst_pts.db(j,0); dy[i] = dst_pts.db(j+n,0);
+      }
+      xmax = (int)ceil( max(max(dx[0],dx[1]),dx[2]));
+      ymax = (int)ceil( max(max(dy[0],dy[1]),dy[2]));
+      xmin = (int)floor(min(min(dx[0],dx[1]),dx[2]));
+      ymin = (int)floor(min(min(dy[0],dy[1]),dy[2]));
+      if( (xmin < 0) || (xmax >= dst_img[0].cols) || 
+	  (ymin < 0) || (ymax >= dst_img[0].rows) ||
+	 (((dx[1] - dx[0])*(dy[0] - dy[2])+(dy[1] - dy[0])*(dx[2] - dx[0]))/
+	   ((sx[1] - sx[0])*(sy[0] - sy[2])+(sy[1] - sy[0])*(sx[2] - sx[0]))<=0)){
+	continue;
+      }
+      for(i = 0; i < 3; i++){
+	X.db(i,0) = dx[i]; X.db(i,1) = dy[i]; X.db(i,2) = 1.0;
+	Y.db(i,0) = sx[i]; Y.db(i,1) = sy[i];
+      }
+      cv::invert(X,Xi,cv::DECOMP_SVD); A = (Xi*Y).t();
+      for(i = ymin; i <= ymax; i++){
+	for(j = xmin; j <= xmax; j++){
+	  if(FACETRACKER::sameSide(j,i,dx[0],dy[0],dx[1],dy[1],dx[2],dy[2]) &&
+	     FACETRACKER::sameSide(j,i,dx[1],dy[1],dx[0],dy[0],dx[2],dy[2]) &&
+	     FACETRACKER::sameSide(j,i,dx[2],dy[2],dx[0],dy[0],dx[1],dy[1])){
+	    x = A.db(0,0)*j + A.db(0,1)*i + A.db(0,2);
+	    y = A.db(1,0)*j + A.db(1,1)*i + A.db(1,2);
+	    for(k = 0; k < c; k++)
+	      dst_img[k].at<uchar>(i,j) = 
+		(uchar)(FACETRACKER::bilinInterp(src_img[k],x,y)+0.5);
+	  }
+	}
+      }
+    }return;
+  }
+};
+//=============================================================================
 void myAvatar::WarpTexture(cv::Mat &src_pts,cv::Mat &dst_pts,
 			 vector<cv::Mat> &src_img,
 			 vector<cv::Mat> &dst_img,
 			 cv::Mat &tri)
 {
-  int l,n = src_pts.rows/2,c = src_img.size();
+  int n = src_pts.rows/2;
 
   //check points are within image
   {
@@ -485,47 +537,8 @@ void myAvatar::WarpTexture(cv::Mat &src_pts,cv::Mat &dst_pts,
       }
     }
   }
-#ifdef _OPENMP
-#pragma omp parallel for
-#endif
-  for(l = 0; l < tri.rows; l++){
-    int i,j,k,xmin,ymin,xmax,ymax;
-    double dx[3],dy[3],sx[3],sy[3],x,y;
-    cv::Mat A(2,3,CV_64F),Xi(3,3,CV_64F),X(3,3,CV_64F),Y(3,2,CV_64F);
-    for(i = 0; i < 3; i++){
-      j = tri.it(l,i);
-      sx[i] = src_pts.db(j,0); sy[i] = src_pts.db(j+n,0);
-      dx[i] = dst_pts.db(j,0); dy[i] = dst_pts.db(j+n,0);
-    }
-    xmax = (int)ceil( max(max(dx[0],dx[1]),dx[2]));
-    ymax = (int)ceil( max(max(dy[0],dy[1]),dy[2]));
-    xmin = (int)floor(min(min(dx[0],dx[1]),dx[2]));
-    ymin = (int)floor(min(min(dy[0],dy[1]),dy[2]));
-    if( (xmin < 0) || (xmax >= dst_img[0].cols) || 
-	(ymin < 0) || (ymax >= dst_img[0].rows) ||
-       (((dx[1] - dx[0])*(dy[0] - dy[2])+(dy[1] - dy[0])*(dx[2] - dx[0]))/
-	 ((sx[1] - sx[0])*(sy[0] - sy[2])+(sy[1] - sy[0])*(sx[2] - sx[0]))<=0)){
-      continue;
-    }
-    for(i = 0; i < 3; i++){
-      X.db(i,0) = dx[i]; X.db(i,1) = dy[i]; X.db(i,2) = 1.0;
-      Y.db(i,0) = sx[i]; Y.db(i,1) = sy[i];
-    }
-    cv::invert(X,Xi,cv::DECOMP_SVD); A = (Xi*Y).t();
-    for(i = ymin; i <= ymax; i++){
-      for(j = xmin; j <= xmax; j++){
-	if(FACETRACKER::sameSide(j,i,dx[0],dy[0],dx[1],dy[1],dx[2],dy[2]) &&
-	   FACETRACKER::sameSide(j,i,dx[1],dy[1],dx[0],dy[0],dx[2],dy[2]) &&
-	   FACETRACKER::sameSide(j,i,dx[2],dy[2],dx[0],dy[0],dx[1],dy[1])){
-	  x = A.db(0,0)*j + A.db(0,1)*i + A.db(0,2);
-	  y = A.db(1,0)*j + A.db(1,1)*i + A.db(1,2);
-	  for(k = 0; k < c; k++)
-	    dst_img[k].at<uchar>(i,j) = 
-	      (uchar)(FACETRACKER::bilinInterp(src_img[k],x,y)+0.5);
-	}
-      }
-    }
-  }return;
+  WarpBody body(src_pts,dst_pts,tri,src_img,dst_img);
+  FACETRACKER::ParallelFor(0,tri.rows,body); return;
 }
 //=============================================================================
 void myAvatar::GetIdxPts(cv::Mat &shape,cv::Mat &idx,cv::Mat &ishape,bool twoD)
@@ -1390,7 +1403,8 @@ double KSmooth::Kernel(cv::Mat &x1,cv::Mat &x2,double sigma)
 ShapeExpMap& ShapeExpMap::operator=(ShapeExpMap const&rhs)
 {
   _pdm = rhs._pdm; _reg = rhs._reg;
-  plocal_.create(_pdm.nModes(),1,CV_64F); pglobl_.create(6,1,CV_64F);
+  plocal_.create(_pdm.nModes(),1,CV_64F); plocal_ = cv::Scalar(0);
+  pglobl_.create(6,1,CV_64F);
   shape_.create(3*_pdm.nPoints(),1,CV_64F);
   R_.create(3,3,CV_64F); Ri_.create(3,3,CV_64F); return *this;
 }
@@ -1399,7 +1413,8 @@ void ShapeExpMap::Read(ifstream &s)
 {
   int N; s >> N; _reg.resize(N); _pdm.Read(s); 
   for(unsigned i = 0; i < _reg.size(); i++)_reg[i].Read(s);
-  plocal_.create(_pdm.nModes(),1,CV_64F); pglobl_.create(6,1,CV_64F);
+  plocal_.create(_pdm.nModes(),1,CV_64F); plocal_ = cv::Scalar(0);
+  pglobl_.create(6,1,CV_64F);
   shape_.create(3*_pdm.nPoints(),1,CV_64F);
   R_.create(3,3,CV_64F); Ri_.create(3,3,CV_64F); 
 }
@@ -1415,7 +1430,8 @@ void ShapeExpMap::ReadBinary(ifstream &s, bool readType)
   _reg.resize(N); _pdm.ReadBinary(s); 
   for(unsigned i = 0; i < _reg.size(); i++)_reg[i].ReadBinary(s);
   
-  plocal_.create(_pdm.nModes(),1,CV_64F); pglobl_.create(6,1,CV_64F);
+  plocal_.create(_pdm.nModes(),1,CV_64F); plocal_ = cv::Scalar(0);
+  pglobl_.create(6,1,CV_64F);
   shape_.create(3*_pdm.nPoints(),1,CV_64F);
   R_.create(3,3,CV_64F); Ri_.create(3,3,CV_64F); 
 }
@@ -1443,7 +1459,8 @@ void ShapeExpMap::Train(FACETRACKER::PDM3D &pdm,
 {
   assert(express.size() == neutral.size());
   _pdm = pdm; _reg.resize(express.size());
-  plocal_.create(_pdm.nModes(),1,CV_64F); pglobl_.create(6,1,CV_64F);
+  plocal_.create(_pdm.nModes(),1,CV_64F); plocal_ = cv::Scalar(0);
+  pglobl_.create(6,1,CV_64F);
   shape_.create(3*_pdm.nPoints(),1,CV_64F);
   R_.create(3,3,CV_64F); Ri_.create(3,3,CV_64F);
   for(unsigned i = 0; i < _reg.size(); i++){
@@ -1462,16 +1479,18 @@ void ShapeExpMap::Train(FACETRACKER::PDM3D &pdm,
 //=============================================================================
 vector<cv::Mat> ShapeExpMap::Generate(cv::Mat &s2D)
 {
-  shape_ = this->CalcNormed3D(s2D);
+  shape_ = this->CalcNormed3D(s2D,true);
   vector<cv::Mat> s3D(_reg.size()+1); s3D[0] = shape_.clone();
   for(unsigned i = 0; i < _reg.size(); i++)
     s3D[i+1] = shape_+_reg[i].Predict(shape_);
   return s3D;
 }
 //=============================================================================
-cv::Mat ShapeExpMap::CalcNormed3D(cv::Mat &s2D)
+cv::Mat ShapeExpMap::CalcNormed3D(cv::Mat &s2D,bool warm)
 {
-  _pdm.CalcParams(s2D,plocal_,pglobl_); _pdm.CalcShape3D(shape_,plocal_);
+  if(warm)_pdm.CalcParams(s2D,plocal_,pglobl_,PDM_ITER); 
+  else    _pdm.CalcParams(s2D,plocal_,pglobl_);
+  _pdm.CalcShape3D(shape_,plocal_);
   FACETRACKER::Euler2Rot(R_,pglobl_.db(1,0),pglobl_.db(2,0),pglobl_.db(3,0)); 
   R_ *= pglobl_.db(0,0); cv::invert(R_,Ri_,cv::DECOMP_SVD);
   cv::Mat x(3,1,CV_64F),y(3,1,CV_64F); int n = _pdm.nPoints();
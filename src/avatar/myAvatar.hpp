@@ -86,7 +86,8 @@ namespace AVATAR
 	       std::vector<std::vector<cv::Mat> > neutral,
 	       double sigma);
     std::vector<cv::Mat> Generate(cv::Mat &s2D);
-    cv::Mat CalcNormed3D(cv::Mat &s2D);
+    cv::Mat CalcNormed3D(cv::Mat &s2D,
+			 bool warm = false); //start from the last call's fit
   protected:
     cv::Mat plocal_,pglobl_,shape_,R_,Ri_;
   };
@@ -44,6 +44,9 @@ print_usage()
     "                            The default is 5.\n"
     "  --title <string>          The window title to use.\n"                  
     "  --3d                      Save 3D shape instead of the 2D shape.\n"
+    "  --yuv <format>            Read the video as raw frames, one after the other,\n"
+    "                            in the format gray, nv12, nv21 or i420.\n"
+    "  --size <width>x<height>   The size of the raw frames.\n"
     "  --verbose                 Display information whilst processing.\n"
     "\n"
     "Default mode:\n"
@@ -61,7 +64,8 @@ print_usage()
     "[landmarks-argument] is specified, then it represents a format string\n"
     "used by sprintf. The template must accept at most one unsigned integer\n"
     "value. If no [landmarks-argument] is given, then the tracking is displayed\n"
-    "to the screen.\n"
+    "to the screen. Raw frames given with --yuv are tracked in place without\n"
+    "being converted.\n"
     "\n";
   
   std::cout << text << std::endl;
@@ -81,6 +85,9 @@ struct Configuration
   std::string window_title;
   bool verbose;
   bool save_3d_points;
+  int raw_format;		// FrameView format, or -1 for a video file
+  int raw_width;
+  int raw_height;
 
   int circle_radius;
   int circle_thickness;
@@ -127,6 +134,9 @@ run_program(int argc, char **argv)
   cfg.circle_linetype = 8;
   cfg.circle_shift = 0;  
   cfg.save_3d_points = false;
+  cfg.raw_format = -1;
+  cfg.raw_width = 0;
+  cfg.raw_height = 0;
 
   for (int i = 1; i < argc; i++) {
     std::string argument(argv[i]);
@@ -153,6 +163,22 @@ run_program(int argc, char **argv)
       cfg.verbose = true;
     } else if (argument == "--3d") {
       cfg.save_3d_points = true;
+    } else if (argument == "--yuv") {
+      std::string format = get_argument(&i, argc, argv);
+      if (format == "gray")
+	cfg.raw_format = FrameView::GRAY;
+      else if (format == "nv12")
+	cfg.raw_format = FrameView::NV12;
+      else if (format == "nv21")
+	cfg.raw_format = FrameView::NV21;
+      else if (format == "i420")
+	cfg.raw_format = FrameView::I420;
+      else
+	throw make_runtime_error("Unknown raw frame format '%s'", format.c_str());
+    } else if (argument == "--size") {
+      std::string size = get_argument(&i, argc, argv);
+      if (sscanf(size.c_str(), "%dx%d", &cfg.raw_width, &cfg.raw_height) != 2)
+	throw make_runtime_error("Unable to parse frame size '%s'", size.c_str());
     } else if (!assign_argument(argument, image_argument, landmarks_argument)) {
       throw make_runtime_error("Unable to process argument '%s'", argument.c_str());
     }
@@ -163,6 +189,9 @@ run_program(int argc, char **argv)
     return 0;
   }
 
+  if ((cfg.raw_format >= 0) && ((cfg.raw_width <= 0) || (cfg.raw_height <= 0)))
+    throw make_runtime_error("The switch --yuv needs the frame size given with --size.");
+
   if (lists_mode && video_mode)
     throw make_runtime_error("The operator is confused as the switches --lists and --video are present on the command line.");
 
@@ -266,6 +295,33 @@ run_lists_mode(const Configuration &cfg,
   return 0;
 }
 
+static size_t
+raw_frame_size(const Configuration &cfg)
+{
+  size_t luma = size_t(cfg.raw_width) * cfg.raw_height;
+  if (cfg.raw_format == FrameView::GRAY)
+    return luma;
+  else
+    return luma + 2 * size_t(cfg.raw_width / 2) * (cfg.raw_height / 2);
+}
+
+static FrameView
+raw_frame_view(const Configuration &cfg, const uint8_t *data)
+{
+  int w = cfg.raw_width;
+  int h = cfg.raw_height;
+  const uint8_t *chroma = data + w * h;
+  switch (cfg.raw_format) {
+  case FrameView::NV12:
+  case FrameView::NV21:
+    return FrameView(data, w, h, w, cfg.raw_format, chroma, NULL, w);
+  case FrameView::I420:
+    return FrameView(data, w, h, w, cfg.raw_format, chroma, chroma + (w/2) * (h/2), w/2);
+  default:
+    return FrameView(data, w, h, w);
+  }
+}
+
 int
 run_video_mode(const Configuration &cfg,
 	       const CommandLineArgument<std::string> &image_argument,
@@ -277,34 +333,62 @@ run_video_mode(const Configuration &cfg,
   assert(tracker);
   assert(tracker_params);
 
-  cv::VideoCapture input(image_argument->c_str());
-  if (!input.isOpened())
-    throw make_runtime_error("Unable to open video file '%s'", image_argument->c_str());
+  cv::VideoCapture input;
+  std::ifstream raw_input;
+  std::vector<uint8_t> raw_frame;
+  if (cfg.raw_format < 0) {
+    input.open(image_argument->c_str());
+    if (!input.isOpened())
+      throw make_runtime_error("Unable to open video file '%s'", image_argument->c_str());
+  } else {
+    raw_input.open(image_argument->c_str(), std::ios::binary);
+    if (!raw_input.is_open())
+      throw make_runtime_error("Unable to open video file '%s'", image_argument->c_str());
+    raw_frame.resize(raw_frame_size(cfg));
+  }
 
   cv::Mat image;
 
   std::vector<char> pathname_buffer;
   pathname_buffer.resize(1000);
 
-  input >> image;
+  bool displaying = !have_argument_p(landmarks_argument) || cfg.verbose;
   int frame_number = 1;
 
-  while ((image.rows > 0) && (image.cols > 0)) {
-    if (cfg.verbose) {
-      printf(" Frame number %d\r", frame_number);
-      fflush(stdout);
+  while (true) {
+    int result;
+    if (cfg.raw_format < 0) {
+      input >> image;
+      if ((image.rows == 0) || (image.cols == 0))
+	break;
+
+      // the tracker converts colour frames itself, and only where it
+      // needs to while following a face
+      if ((image.type() != cv::DataType<cv::Vec<uint8_t,3> >::type) &&
+	  (image.type() != cv::DataType<uint8_t>::type))
+	throw make_runtime_error("Do not know how to convert video frame to a grayscale image.");
+
+      if (cfg.verbose) {
+	printf(" Frame number %d\r", frame_number);
+	fflush(stdout);
+      }
+
+      result = tracker->Track(image, tracker_params);
+    } else {
+      if (!raw_input.read(reinterpret_cast<char *>(&raw_frame[0]), raw_frame.size()))
+	break;
+
+      if (cfg.verbose) {
+	printf(" Frame number %d\r", frame_number);
+	fflush(stdout);
+      }
+
+      FrameView view = raw_frame_view(cfg, &raw_frame[0]);
+      result = tracker->Track(view, tracker_params);
+      if (displaying)
+	view.BGR(image);
     }
 
-    cv::Mat_<uint8_t> gray_image;
-    if (image.type() == cv::DataType<cv::Vec<uint8_t,3> >::type)
-      cv::cvtColor(image, gray_image, CV_BGR2GRAY);
-    else if (image.type() == cv::DataType<uint8_t>::type)
-      gray_image = image;
-    else
-      throw make_runtime_error("Do not know how to convert video frame to a grayscale image.");
-
-    int result = tracker->Track(gray_image, tracker_params);
-
     std::vector<cv::Point_<double> > shape;
     std::vector<cv::Point3_<double> > shape3D;
     Pose pose;
@@ -333,7 +417,6 @@ run_video_mode(const Configuration &cfg,
       display_data(cfg, image, shape, pose);
     }
 
-    input >> image;
     frame_number++;
   }
 
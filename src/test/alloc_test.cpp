@@ -0,0 +1,186 @@
+// CSIRO has filed various patents which cover the Software. 
+
+// CSIRO grants to you a license to any patents granted for inventions
+// implemented by the Software for academic, research and non-commercial
+// use only.
+
+// CSIRO hereby reserves all rights to its inventions implemented by the
+// Software and any patents subsequently granted for those inventions
+// that are not expressly granted to you.  Should you wish to license the
+// patents relating to the Software for commercial use please contact
+// CSIRO IP & Licensing, Gautam Tendulkar (gautam.tendulkar@csiro.au) or
+// Nick Marsh (nick.marsh@csiro.au)
+
+// This software is provided under the CSIRO OPEN SOURCE LICENSE
+// (GPL2) which can be found in the LICENSE file located in the top
+// most directory of the source code.
+
+// Copyright CSIRO 2013
+
+#include <tracker/FaceTracker.hpp>
+#include <tracker/myFaceTracker.hpp>
+#include <iostream>
+#include <limits>
+#include <new>
+#include <cerrno>
+
+#include <test/command-line-options.hpp>
+#include <test/test-video.hpp>
+
+//==============================================================================
+// Every heap allocation made by the process goes through the functions
+// below; allocations are only counted while counting_ is set.
+static volatile bool counting_ = false;
+static volatile long nalloc_ = 0;
+
+#ifdef __GLIBC__
+extern "C" {
+  void* __libc_malloc(size_t size);
+  void* __libc_calloc(size_t n,size_t size);
+  void* __libc_realloc(void* ptr,size_t size);
+  void* __libc_memalign(size_t align,size_t size);
+  void  __libc_free(void* ptr);
+
+  void* malloc(size_t size)
+  {if(counting_)nalloc_++; return __libc_malloc(size);}
+  void* calloc(size_t n,size_t size)
+  {if(counting_)nalloc_++; return __libc_calloc(n,size);}
+  void* realloc(void* ptr,size_t size)
+  {if(counting_)nalloc_++; return __libc_realloc(ptr,size);}
+  void* memalign(size_t align,size_t size)
+  {if(counting_)nalloc_++; return __libc_memalign(align,size);}
+  int posix_memalign(void** ptr,size_t align,size_t size)
+  {
+    if(counting_)nalloc_++; 
+    *ptr = __libc_memalign(align,size); return (*ptr == NULL) ? ENOMEM : 0;
+  }
+  void free(void* ptr){__libc_free(ptr);}
+}
+#define ALLOC_HOOKS 1
+#else
+#define ALLOC_HOOKS 0
+#endif
+
+void* operator new(size_t size) throw(std::bad_alloc)
+{
+  if(counting_)nalloc_++;
+  void* p = malloc(size == 0 ? 1 : size); if(!p)throw std::bad_alloc(); 
+  return p;
+}
+void* operator new[](size_t size) throw(std::bad_alloc)
+{return operator new(size);}
+void operator delete(void* p) throw(){free(p);}
+void operator delete[](void* p) throw(){free(p);}
+//==============================================================================
+int main(int argc, char** argv)
+{
+  std::cout << "Usage: ./alloc_test [options]" 
+	    << std::endl
+	    << "Count the heap allocations made by the tracker once it has settled on a face." << std::endl
+	    << "options: " << std::endl
+	    << "  --video camera_index_or_filename       which camera to use (default 0) or a pathname to a video file" << std::endl
+	    << "  --frames integer                       number of frames to track (default 300)" << std::endl
+	    << "  --warmup integer                       tracked frames after each detection that may allocate (default 1)" << std::endl
+	    << "  --tracker-threshold integer            threshold used to reset tracking (default 6)" << std::endl
+	    << "  --face-tracker-file path               Face Tracker Configuration File (default src/tracker/resources/face.mytracker.binary)" << std::endl
+	    << "  --face-tracker-parameters-file path    Face Tracker Parameters File (default src/tracker/resources/face.mytrackerparams.binary)" << std::endl
+	    << "  --help or -h                           Show this informative help message" << std::endl
+	    << std::endl;
+
+  OptionDescriptions descriptions;
+  descriptions.registerIdentifier("video", "--video", OptionDescription::ARGUMENT_REQUIRED);
+  descriptions.registerIdentifier("frames", "--frames", OptionDescription::ARGUMENT_REQUIRED);
+  descriptions.registerIdentifier("warmup", "--warmup", OptionDescription::ARGUMENT_REQUIRED);
+  descriptions.registerIdentifier("tracker-threshold","--tracker-threshold", OptionDescription::ARGUMENT_REQUIRED);
+  descriptions.registerIdentifier("face-tracker-parameters-file","--face-tracker-parameters-file", OptionDescription::ARGUMENT_REQUIRED);
+  descriptions.registerIdentifier("face-tracker-file","--face-tracker-file", OptionDescription::ARGUMENT_REQUIRED);
+  descriptions.registerIdentifier("help","--help", OptionDescription::ARGUMENT_NONE);
+  descriptions.registerOption("help","-h");
+
+  Options options;
+  std::string video;
+  int frames;
+  int warmup;
+  int tracker_threshold;
+  std::string face_tracker_file;
+  std::string face_tracker_parameters_file;
+  try {
+    descriptions.processOptions(argc, argv, options);
+
+    video                          = options.argument("video", "0");
+    frames                         = options.argument<int>("frames",300);
+    warmup                         = options.argument<int>("warmup",1);
+    tracker_threshold              = options.argument<int>("tracker-threshold",6);    
+    face_tracker_file              = options.argument("face-tracker-file", "src/tracker/resources/face.mytracker.binary");
+    face_tracker_parameters_file   = options.argument("face-tracker-parameters-file", "src/tracker/resources/face.mytrackerparams.binary");
+
+    if (options.isPresent("help"))
+      return 0;
+
+  } catch (std::exception &e) {
+    std::cerr << "Option processing failed: " << e.what() << std::endl;
+    return -1;
+  }
+  if (!ALLOC_HOOKS) {
+    std::cerr << "Allocation counting is not supported on this platform." << std::endl;
+    return 0;
+  }
+
+  FACETRACKER::FaceTrackerParams * p = FACETRACKER::LoadFaceTrackerParams(face_tracker_parameters_file.c_str());
+  FACETRACKER::FaceTracker* tracker = 
+    FACETRACKER::LoadFaceTracker(face_tracker_file.c_str());
+  assert((p != NULL) && (tracker != NULL));
+  FACETRACKER::myFaceTrackerParams* mp = 
+    dynamic_cast<FACETRACKER::myFaceTrackerParams*>(p);
+  if (mp == NULL) {
+    std::cerr << "The parameters file is not for myFaceTracker." << std::endl;
+    return -1;
+  }
+  //the configuration that is guaranteed not to allocate, see
+  //myFaceTrackerParams
+  mp->track_type = 0; mp->timeDet = -1; mp->key_interval = 1;
+
+  cv::VideoCapture camera;
+  if (!open_test_video(video, camera))
+    return -1;
+
+  //frames are counted once the tracker has followed the face through
+  //the detection frame and warmup further frames
+  cv::Mat im; int run = 0;
+  int counted = 0,dirty = 0; long total = 0;
+  for (int frame = 0; frame < frames; frame++) {
+    camera >> im;
+    if ((im.rows == 0) || (im.cols == 0)) 
+      break;
+
+    bool count = (run > warmup);
+    long n0 = nalloc_; counting_ = count;
+    int health = tracker->Track(im,p);
+    counting_ = false; long n = nalloc_ - n0;
+
+    if (count) {
+      counted++; total += n;
+      if (n > 0) {
+	dirty++;
+	std::cout << "frame " << frame << ": " << n << " allocations" << std::endl;
+      }
+    }
+    if (health >= tracker_threshold) {
+      run++;
+    } else {
+      run = 0;
+      if (health != FACETRACKER::FaceTracker::TRACKER_FACE_OUT_OF_FRAME)
+	tracker->Reset();
+    }
+  }
+  std::cout << counted << " tracked frames, " << dirty 
+	    << " with allocations, " << total << " allocations in total" 
+	    << std::endl;
+  delete tracker; delete p;
+  if (counted == 0) {
+    std::cerr << "No frame was tracked." << std::endl;
+    return -1;
+  }
+  return (total == 0) ? 0 : 1;
+}
+//==============================================================================
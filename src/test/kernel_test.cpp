@@ -0,0 +1,160 @@
+// CSIRO has filed various patents which cover the Software.
+
+// CSIRO grants to you a license to any patents granted for inventions
+// implemented by the Software for academic, research and non-commercial
+// use only.
+
+// CSIRO hereby reserves all rights to its inventions implemented by the
+// Software and any patents subsequently granted for those inventions
+// that are not expressly granted to you.  Should you wish to license the
+// patents relating to the Software for commercial use please contact
+// CSIRO IP & Licensing, Gautam Tendulkar (gautam.tendulkar@csiro.au) or
+// Nick Marsh (nick.marsh@csiro.au)
+
+// This software is provided under the CSIRO OPEN SOURCE LICENSE
+// (GPL2) which can be found in the LICENSE file located in the top
+// most directory of the source code.
+
+// Copyright CSIRO 2013
+
+#include <tracker/PatchKernels.hpp>
+#include <iostream>
+#include <cmath>
+
+#include <test/command-line-options.hpp>
+
+#define SGN(x) ((x<0) ? 0:1)
+//==============================================================================
+// Reference feature channels, as Patch.cpp computed them before the
+// kernels were vectorised.
+static
+void ref_grad(cv::Mat &im,cv::Mat &grad)
+{
+  int x,y,h = im.rows,w = im.cols; float vx,vy;
+  grad.create(h,w,CV_32F); grad = cv::Scalar(0);
+  for(y = 1; y < h-1; y++){
+    for(x = 1; x < w-1; x++){
+      vx = im.at<float>(y,x+1) - im.at<float>(y,x-1);
+      vy = im.at<float>(y+1,x) - im.at<float>(y-1,x);
+      grad.at<float>(y,x) = vx*vx + vy*vy;
+    }
+  }return;
+}
+//==============================================================================
+static
+void ref_lbp(cv::Mat &im,cv::Mat &lbp)
+{
+  int x,y,h = im.rows,w = im.cols;
+  lbp.create(h,w,CV_32F); lbp = cv::Scalar(0);
+  for(y = 1; y < h-1; y++){
+    for(x = 1; x < w-1; x++){
+      float v0 = im.at<float>(y,x);
+      lbp.at<float>(y,x) =
+	SGN(v0-im.at<float>(y-1,x-1))*2   + SGN(v0-im.at<float>(y-1,x  ))*4 +
+	SGN(v0-im.at<float>(y-1,x+1))*8   + SGN(v0-im.at<float>(y  ,x-1))*16+
+	SGN(v0-im.at<float>(y  ,x+1))*32  + SGN(v0-im.at<float>(y+1,x-1))*64+
+	SGN(v0-im.at<float>(y+1,x  ))*128 + SGN(v0-im.at<float>(y+1,x+1))*256;
+    }
+  }return;
+}
+//==============================================================================
+static
+double max_diff(cv::Mat &a,cv::Mat &b)
+{
+  cv::Mat a64,b64; a.convertTo(a64,CV_64F); b.convertTo(b64,CV_64F);
+  return cv::norm(a64,b64,cv::NORM_INF);
+}
+//==============================================================================
+int main(int argc, char** argv)
+{
+  std::cout << "Usage: ./kernel_test [options]"
+	    << std::endl
+	    << "Compare every patch kernel this CPU supports with cv::matchTemplate and the original feature channels." << std::endl
+	    << "options: " << std::endl
+	    << "  --trials integer                       number of random windows (default 1000)" << std::endl
+	    << "  --seed integer                         random number seed (default 1)" << std::endl
+	    << "  --tolerance real                       largest difference accepted (default 1e-5)" << std::endl
+	    << "  --help or -h                           Show this informative help message" << std::endl
+	    << std::endl;
+
+  OptionDescriptions descriptions;
+  descriptions.registerIdentifier("trials", "--trials", OptionDescription::ARGUMENT_REQUIRED);
+  descriptions.registerIdentifier("seed", "--seed", OptionDescription::ARGUMENT_REQUIRED);
+  descriptions.registerIdentifier("tolerance", "--tolerance", OptionDescription::ARGUMENT_REQUIRED);
+  descriptions.registerIdentifier("help","--help", OptionDescription::ARGUMENT_NONE);
+  descriptions.registerOption("help","-h");
+
+  Options options;
+  int trials,seed;
+  double tolerance;
+  try {
+    descriptions.processOptions(argc, argv, options);
+    trials                         = options.argument<int>("trials",1000);
+    seed                           = options.argument<int>("seed",1);
+    tolerance                      = options.argument<double>("tolerance",1e-5);
+
+    if (options.isPresent("help"))
+      return 0;
+
+  } catch (std::exception &e) {
+    std::cerr << "Option processing failed: " << e.what() << std::endl;
+    return -1;
+  }
+
+  const int kernels[] = {FACETRACKER::KERNEL_SCALAR,
+			 FACETRACKER::KERNEL_AVX2,
+			 FACETRACKER::KERNEL_NEON};
+  const char* names[] = {"scalar","avx2","neon"};
+  int initial = FACETRACKER::PatchKernel(); bool failed = false;
+  for (int k = 0; k < 3; k++) {
+    if (!FACETRACKER::SetPatchKernel(kernels[k])) {
+      std::cout << names[k] << ": not supported by this CPU" << std::endl;
+      continue;
+    }
+    //the same windows for every kernel
+    cv::RNG rng(seed); FACETRACKER::NCC ncc;
+    double ecorr = 0.0,ezero = 0.0,eresp = 0.0,egrad = 0.0,elbp = 0.0;
+    for (int t = 0; t < trials; t++) {
+      int th = rng.uniform(3,16),tw = rng.uniform(3,16);
+      int h = th + rng.uniform(0,20),w = tw + rng.uniform(0,20);
+
+      //windows are views into a larger image, so their rows have a stride
+      cv::Mat big(h+2,w+5,CV_32F),T(th,tw,CV_32F);
+      rng.fill(big,cv::RNG::UNIFORM,0,255); rng.fill(T,cv::RNG::UNIFORM,0,255);
+      cv::Mat im = big(cv::Rect(3,1,w,h));
+      double a = rng.uniform(-10.0,10.0),b = rng.uniform(-5.0,5.0);
+
+      cv::Mat ref,corr,resp,resp_ref;
+      cv::matchTemplate(im,T,ref,CV_TM_CCOEFF_NORMED);
+      ncc.Correlate(im,T,corr); ecorr = std::max(ecorr,max_diff(corr,ref));
+
+      //the overloads taking a zero mean template and its norm
+      cv::Mat Tz = T - cv::mean(T)[0]; double tnorm = cv::norm(Tz);
+      ncc.Correlate(im,Tz,tnorm,corr); ezero = std::max(ezero,max_diff(corr,ref));
+      resp.create(ref.rows,ref.cols,CV_32F);
+      ncc.Response(im,Tz,tnorm,a,b,corr,resp);
+      ref.convertTo(resp_ref,CV_64F); resp_ref = resp_ref*a + b;
+      cv::exp(resp_ref,resp_ref); resp_ref = 1.0/(1.0 + resp_ref);
+      eresp = std::max(eresp,max_diff(resp,resp_ref));
+
+      cv::Mat f,f_ref;
+      f.create(h,w,CV_32F); FACETRACKER::Grad(im,f); ref_grad(im,f_ref);
+      egrad = std::max(egrad,max_diff(f,f_ref)/(255.0*255.0*2.0));
+      f.create(h,w,CV_32F); FACETRACKER::LBP(im,f); ref_lbp(im,f_ref);
+      elbp = std::max(elbp,max_diff(f,f_ref));
+    }
+    bool ok = (ecorr <= tolerance) && (ezero <= tolerance) &&
+      (eresp <= tolerance) && (egrad <= tolerance) && (elbp == 0.0);
+    std::cout << names[k] << ": max difference"
+	      << " correlation " << ecorr
+	      << ", zero mean correlation " << ezero
+	      << ", response " << eresp
+	      << ", gradient (relative) " << egrad
+	      << ", lbp " << elbp
+	      << (ok ? "" : "  FAILED") << std::endl;
+    failed = failed || !ok;
+  }
+  FACETRACKER::SetPatchKernel(initial);
+  return failed ? 1 : 0;
+}
+//==============================================================================
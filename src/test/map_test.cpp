@@ -0,0 +1,168 @@
+// CSIRO has filed various patents which cover the Software.
+
+// CSIRO grants to you a license to any patents granted for inventions
+// implemented by the Software for academic, research and non-commercial
+// use only.
+
+// CSIRO hereby reserves all rights to its inventions implemented by the
+// Software and any patents subsequently granted for those inventions
+// that are not expressly granted to you.  Should you wish to license the
+// patents relating to the Software for commercial use please contact
+// CSIRO IP & Licensing, Gautam Tendulkar (gautam.tendulkar@csiro.au) or
+// Nick Marsh (nick.marsh@csiro.au)
+
+// This software is provided under the CSIRO OPEN SOURCE LICENSE
+// (GPL2) which can be found in the LICENSE file located in the top
+// most directory of the source code.
+
+// Copyright CSIRO 2013
+
+#include <tracker/FaceTracker.hpp>
+#include <tracker/myFaceTracker.hpp>
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <cmath>
+
+#include <test/command-line-options.hpp>
+#include <test/test-video.hpp>
+
+//==============================================================================
+static
+bool same_contents_p(const std::string &a, const std::string &b)
+{
+  std::ifstream sa(a.c_str(), std::ios::binary), sb(b.c_str(), std::ios::binary);
+  if (!sa.is_open() || !sb.is_open())
+    return false;
+  std::istreambuf_iterator<char> ia(sa), ib(sb), end;
+  while ((ia != end) && (ib != end))
+    if (*ia++ != *ib++)
+      return false;
+  return (ia == end) && (ib == end);
+}
+//==============================================================================
+int main(int argc, char** argv)
+{
+  std::cout << "Usage: ./map_test [options]"
+	    << std::endl
+	    << "Check that a memory mapped tracker model tracks exactly as the model it was saved from." << std::endl
+	    << "options: " << std::endl
+	    << "  --video camera_index_or_filename       which camera to use or a pathname to a video file (default none, only compare the saved models)" << std::endl
+	    << "  --frames integer                       number of frames to track (default 300)" << std::endl
+	    << "  --tracker-threshold integer            threshold used to reset tracking (default 6)" << std::endl
+	    << "  --face-tracker-file path               Face Tracker Configuration File (default src/tracker/resources/face.mytracker.binary)" << std::endl
+	    << "  --face-tracker-parameters-file path    Face Tracker Parameters File (default src/tracker/resources/face.mytrackerparams.binary)" << std::endl
+	    << "  --mapped-file path                     where to save the mapped model (default face.mytracker.mapped)" << std::endl
+	    << "  --help or -h                           Show this informative help message" << std::endl
+	    << std::endl;
+
+  OptionDescriptions descriptions;
+  descriptions.registerIdentifier("video", "--video", OptionDescription::ARGUMENT_REQUIRED);
+  descriptions.registerIdentifier("frames", "--frames", OptionDescription::ARGUMENT_REQUIRED);
+  descriptions.registerIdentifier("tracker-threshold","--tracker-threshold", OptionDescription::ARGUMENT_REQUIRED);
+  descriptions.registerIdentifier("face-tracker-parameters-file","--face-tracker-parameters-file", OptionDescription::ARGUMENT_REQUIRED);
+  descriptions.registerIdentifier("face-tracker-file","--face-tracker-file", OptionDescription::ARGUMENT_REQUIRED);
+  descriptions.registerIdentifier("mapped-file","--mapped-file", OptionDescription::ARGUMENT_REQUIRED);
+  descriptions.registerIdentifier("help","--help", OptionDescription::ARGUMENT_NONE);
+  descriptions.registerOption("help","-h");
+
+  Options options;
+  int frames;
+  int tracker_threshold;
+  std::string face_tracker_file;
+  std::string face_tracker_parameters_file;
+  std::string mapped_file;
+  try {
+    descriptions.processOptions(argc, argv, options);
+
+    frames                         = options.argument<int>("frames",300);
+    tracker_threshold              = options.argument<int>("tracker-threshold",6);
+    face_tracker_file              = options.argument("face-tracker-file", "src/tracker/resources/face.mytracker.binary");
+    face_tracker_parameters_file   = options.argument("face-tracker-parameters-file", "src/tracker/resources/face.mytrackerparams.binary");
+    mapped_file                    = options.argument("mapped-file", "face.mytracker.mapped");
+
+    if (options.isPresent("help"))
+      return 0;
+
+  } catch (std::exception &e) {
+    std::cerr << "Option processing failed: " << e.what() << std::endl;
+    return -1;
+  }
+
+  //the model as read from its stream, and the same model after mapping
+  FACETRACKER::FaceTracker* ts =
+    FACETRACKER::LoadFaceTracker(face_tracker_file.c_str());
+  assert(ts != NULL);
+  ts->SaveMapped(mapped_file.c_str());
+  FACETRACKER::FaceTracker* tm =
+    FACETRACKER::LoadFaceTracker(mapped_file.c_str());
+  FACETRACKER::FaceTrackerParams * p = FACETRACKER::LoadFaceTrackerParams(face_tracker_parameters_file.c_str());
+  assert((tm != NULL) && (p != NULL));
+
+  //both must save to the same bytes, as must the mapped model mapped again
+  std::string saved = mapped_file + ".saved",resaved = mapped_file + ".resaved";
+  std::string remapped = mapped_file + ".remapped";
+  ts->Save(saved.c_str(),true); tm->Save(resaved.c_str(),true);
+  tm->SaveMapped(remapped.c_str());
+  bool same = same_contents_p(saved,resaved) && 
+    same_contents_p(mapped_file,remapped);
+  std::cout << "saved models " << (same ? "are identical" : "differ") 
+	    << std::endl;
+  if (!same || !options.isPresent("video")) {
+    delete ts; delete tm; delete p;
+    return same ? 0 : 1;
+  }
+  FACETRACKER::myFaceTrackerParams* mp =
+    dynamic_cast<FACETRACKER::myFaceTrackerParams*>(p);
+  if (mp != NULL) {
+    mp->timeDet = -1; mp->async_init = false; //detections on a timer differ
+  }
+
+  cv::VideoCapture camera;
+  if (!open_test_video(options.argument("video"), camera))
+    return -1;
+
+  //both trackers see the same frames, so every result must be identical
+  cv::Mat im; int nframes = 0,tracked = 0,differ = 0; double worst = 0.0;
+  for (int frame = 0; frame < frames; frame++) {
+    camera >> im;
+    if ((im.rows == 0) || (im.cols == 0))
+      break;
+
+    int hs = ts->Track(im,p),hm = tm->Track(im,p);
+    nframes++;
+    std::vector<cv::Point_<double> > ss = ts->getShape();
+    std::vector<cv::Point_<double> > sm = tm->getShape();
+    double d = 0.0;
+    if (ss.size() != sm.size())
+      d = HUGE_VAL;
+    for (size_t i = 0; (i < ss.size()) && (i < sm.size()); i++)
+      d = std::max(d,std::max(std::fabs(ss[i].x - sm[i].x),
+			      std::fabs(ss[i].y - sm[i].y)));
+    if ((hs != hm) || (d > 0.0)) {
+      differ++; worst = std::max(worst,d);
+      std::cout << "frame " << frame << ": health " << hs << " and " << hm
+		<< ", landmarks differ by up to " << d << " px" << std::endl;
+    }
+    if (hs >= tracker_threshold)
+      tracked++;
+    if ((hs < tracker_threshold) &&
+	(hs != FACETRACKER::FaceTracker::TRACKER_FACE_OUT_OF_FRAME))
+      ts->Reset();
+    if ((hm < tracker_threshold) &&
+	(hm != FACETRACKER::FaceTracker::TRACKER_FACE_OUT_OF_FRAME))
+      tm->Reset();
+  }
+  delete ts; delete tm; delete p;
+  if (nframes == 0) {
+    std::cerr << "No frame was read." << std::endl;
+    return -1;
+  }
+  std::cout << nframes << " frames, " << tracked << " tracked, "
+	    << differ << " differed";
+  if (differ > 0)
+    std::cout << ", landmarks by up to " << worst << " px";
+  std::cout << std::endl;
+  return (differ > 0) ? 1 : 0;
+}
+//==============================================================================
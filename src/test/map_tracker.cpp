@@ -0,0 +1,37 @@
+// CSIRO has filed various patents which cover the Software. 
+
+// CSIRO grants to you a license to any patents granted for inventions
+// implemented by the Software for academic, research and non-commercial
+// use only.
+
+// CSIRO hereby reserves all rights to its inventions implemented by the
+// Software and any patents subsequently granted for those inventions
+// that are not expressly granted to you.  Should you wish to license the
+// patents relating to the Software for commercial use please contact
+// CSIRO IP & Licensing, Gautam Tendulkar (gautam.tendulkar@csiro.au) or
+// Nick Marsh (nick.marsh@csiro.au)
+
+// This software is provided under the CSIRO OPEN SOURCE LICENSE
+// (GPL2) which can be found in the LICENSE file located in the top
+// most directory of the source code.
+
+// Copyright CSIRO 2013
+
+#include <tracker/FaceTracker.hpp>
+#include <iostream>
+using namespace std;
+//=============================================================================
+int main(int argc, const char** argv)
+{
+  if(argc < 3){
+    cout << "Usage: ./map_tracker tracker mapped_tracker" << endl
+	 << "Save a face tracker model in the memory mapped layout" << endl;
+    return 0;
+  }
+  FACETRACKER::FaceTracker* tracker = FACETRACKER::LoadFaceTracker(argv[1]);
+  if(tracker == NULL){
+    cout << "Failed loading face tracker " << argv[1] << endl; return 1;
+  }
+  tracker->SaveMapped(argv[2]); delete tracker; return 0;
+}
+//=============================================================================
@@ -0,0 +1,156 @@
+// CSIRO has filed various patents which cover the Software. 
+
+// CSIRO grants to you a license to any patents granted for inventions
+// implemented by the Software for academic, research and non-commercial
+// use only.
+
+// CSIRO hereby reserves all rights to its inventions implemented by the
+// Software and any patents subsequently granted for those inventions
+// that are not expressly granted to you.  Should you wish to license the
+// patents relating to the Software for commercial use please contact
+// CSIRO IP & Licensing, Gautam Tendulkar (gautam.tendulkar@csiro.au) or
+// Nick Marsh (nick.marsh@csiro.au)
+
+// This software is provided under the CSIRO OPEN SOURCE LICENSE
+// (GPL2) which can be found in the LICENSE file located in the top
+// most directory of the source code.
+
+// Copyright CSIRO 2013
+
+#include <tracker/FaceTracker.hpp>
+#include <tracker/myFaceTracker.hpp>
+#include <iostream>
+#include <cmath>
+
+#include <test/command-line-options.hpp>
+#include <test/test-video.hpp>
+
+//==============================================================================
+static
+int track(FACETRACKER::FaceTracker* tracker,cv::Mat &im,
+	  FACETRACKER::FaceTrackerParams* p,int tracker_threshold,double &ms)
+{
+  int64 t = cv::getTickCount();
+  int health = tracker->Track(im,p);
+  ms += 1000.0*(cv::getTickCount() - t)/cv::getTickFrequency();
+  if ((health < tracker_threshold) && 
+      (health != FACETRACKER::FaceTracker::TRACKER_FACE_OUT_OF_FRAME))
+    tracker->Reset();
+  return health;
+}
+//==============================================================================
+int main(int argc, char** argv)
+{
+  std::cout << "Usage: ./precision_test [options]" 
+	    << std::endl
+	    << "Compare the float32 tracking pipeline with the double one on the same frames." << std::endl
+	    << "options: " << std::endl
+	    << "  --video camera_index_or_filename       which camera to use (default 0) or a pathname to a video file" << std::endl
+	    << "  --frames integer                       number of frames to track (default 300)" << std::endl
+	    << "  --tracker-threshold integer            threshold used to reset tracking (default 6)" << std::endl
+	    << "  --face-tracker-file path               Face Tracker Configuration File (default src/tracker/resources/face.mytracker.binary)" << std::endl
+	    << "  --face-tracker-parameters-file path    Face Tracker Parameters File (default src/tracker/resources/face.mytrackerparams.binary)" << std::endl
+	    << "  --verbose                              Print the landmark difference of every frame" << std::endl
+	    << "  --help or -h                           Show this informative help message" << std::endl
+	    << std::endl;
+
+  OptionDescriptions descriptions;
+  descriptions.registerIdentifier("video", "--video", OptionDescription::ARGUMENT_REQUIRED);
+  descriptions.registerIdentifier("frames", "--frames", OptionDescription::ARGUMENT_REQUIRED);
+  descriptions.registerIdentifier("tracker-threshold","--tracker-threshold", OptionDescription::ARGUMENT_REQUIRED);
+  descriptions.registerIdentifier("face-tracker-parameters-file","--face-tracker-parameters-file", OptionDescription::ARGUMENT_REQUIRED);
+  descriptions.registerIdentifier("face-tracker-file","--face-tracker-file", OptionDescription::ARGUMENT_REQUIRED);
+  descriptions.registerIdentifier("verbose","--verbose", OptionDescription::ARGUMENT_NONE);
+  descriptions.registerIdentifier("help","--help", OptionDescription::ARGUMENT_NONE);
+  descriptions.registerOption("help","-h");
+
+  Options options;
+  std::string video;
+  int frames;
+  int tracker_threshold;
+  bool verbose;
+  std::string face_tracker_file;
+  std::string face_tracker_parameters_file;
+  try {
+    descriptions.processOptions(argc, argv, options);
+
+    video                          = options.argument("video", "0");
+    frames                         = options.argument<int>("frames",300);
+    tracker_threshold              = options.argument<int>("tracker-threshold",6);    
+    face_tracker_file              = options.argument("face-tracker-file", "src/tracker/resources/face.mytracker.binary");
+    face_tracker_parameters_file   = options.argument("face-tracker-parameters-file", "src/tracker/resources/face.mytrackerparams.binary");
+    verbose                        = options.isPresent("verbose");
+
+    if (options.isPresent("help"))
+      return 0;
+
+  } catch (std::exception &e) {
+    std::cerr << "Option processing failed: " << e.what() << std::endl;
+    return -1;
+  }
+
+  //the same models and parameters, the second tracker in float32
+  FACETRACKER::FaceTrackerParams * pd = FACETRACKER::LoadFaceTrackerParams(face_tracker_parameters_file.c_str());
+  FACETRACKER::FaceTrackerParams * pf = FACETRACKER::LoadFaceTrackerParams(face_tracker_parameters_file.c_str());
+  FACETRACKER::FaceTracker* td = 
+    FACETRACKER::LoadFaceTracker(face_tracker_file.c_str());
+  FACETRACKER::FaceTracker* tf = 
+    FACETRACKER::LoadFaceTracker(face_tracker_file.c_str());
+  assert((pd != NULL) && (pf != NULL) && (td != NULL) && (tf != NULL));
+  FACETRACKER::myFaceTrackerParams* mpf = 
+    dynamic_cast<FACETRACKER::myFaceTrackerParams*>(pf);
+  if (mpf == NULL) {
+    std::cerr << "The parameters file is not for myFaceTracker." << std::endl;
+    return -1;
+  }
+  mpf->precision = CV_32F;
+
+  cv::VideoCapture camera;
+  if (!open_test_video(video, camera))
+    return -1;
+
+  //landmark differences are taken over frames both trackers accept
+  cv::Mat im; int nframes = 0,both = 0,agree = 0;
+  double msd = 0.0,msf = 0.0,mean = 0.0,worst = 0.0;
+  for (int frame = 0; frame < frames; frame++) {
+    camera >> im;
+    if ((im.rows == 0) || (im.cols == 0)) 
+      break;
+
+    int hd = track(td,im,pd,tracker_threshold,msd);
+    int hf = track(tf,im,pf,tracker_threshold,msf);
+    nframes++;
+    if ((hd >= tracker_threshold) == (hf >= tracker_threshold))
+      agree++;
+    if ((hd < tracker_threshold) || (hf < tracker_threshold))
+      continue;
+
+    std::vector<cv::Point_<double> > sd = td->getShape();
+    std::vector<cv::Point_<double> > sf = tf->getShape();
+    double dmean = 0.0,dmax = 0.0;
+    for (size_t i = 0; i < sd.size(); i++) {
+      double dx = sd[i].x - sf[i].x,dy = sd[i].y - sf[i].y;
+      double d = std::sqrt(dx*dx + dy*dy);
+      dmean += d; if (d > dmax) dmax = d;
+    }
+    if (sd.size() > 0) dmean /= sd.size();
+    both++; mean += dmean; if (dmax > worst) worst = dmax;
+    if (verbose)
+      std::cout << "frame " << frame << ": mean " << dmean 
+		<< " px, max " << dmax << " px" << std::endl;
+  }
+  if (nframes == 0) {
+    std::cerr << "No frame was read." << std::endl;
+    return -1;
+  }
+  std::cout << nframes << " frames, health agreed on " << agree
+	    << ", both tracking on " << both << std::endl;
+  if (both > 0)
+    std::cout << "landmark difference: mean " << mean/both 
+	      << " px, max " << worst << " px" << std::endl;
+  std::cout << "time per frame: double " << msd/nframes 
+	    << " ms, float " << msf/nframes << " ms" << std::endl;
+  delete td; delete tf; delete pd; delete pf;
+  return 0;
+}
+//==============================================================================
@@ -98,6 +98,7 @@ int main(int argc, char** argv)
 	    << "  --initialise-user-on-first-frame       Initialise the avatar synthesis code on the first frame." << std::endl
 	    << "  --hide-avatar-thumbnail                Hide the avatar thumbnail drawn on the input video." << std::endl
 	    << "  --maximum-number-of-input-frames max   The maximum number of input frames to process." << std::endl
+	    << "  --profile                              Print the time taken by each stage of the tracker on exit." << std::endl
 	    << std::endl;
 
   OptionDescriptions descriptions;
@@ -115,6 +116,7 @@ int main(int argc, char** argv)
   descriptions.registerIdentifier("help","--help", OptionDescription::ARGUMENT_NONE);
   descriptions.registerOption("help","-h");
   descriptions.registerIdentifier("maximum-number-of-input-frames", "--maximum-number-of-input-frames", OptionDescription::ARGUMENT_REQUIRED);
+  descriptions.registerIdentifier("profile", "--profile", OptionDescription::ARGUMENT_NONE);
 
   Options options;
   int camera_index;  
@@ -132,6 +134,7 @@ int main(int argc, char** argv)
   bool hide_avatar_thumbnail;
   bool initialise_user_on_first_frame;
   int maximum_number_of_input_frames;
+  bool profile_p;
   try {
     descriptions.processOptions(argc, argv, options);
 
@@ -157,6 +160,7 @@ int main(int argc, char** argv)
     initialise_user_on_first_frame = options.isPresent("initialise-user-on-first-frame");
     hide_avatar_thumbnail          = options.isPresent("hide-avatar-thumbnail");
     maximum_number_of_input_frames = options.argument<int>("maximum-number-of-input-frames", std::numeric_limits<int>::max());
+    profile_p                      = options.isPresent("profile");
 
     if (options.isPresent("help"))
       return 0;
@@ -177,6 +181,7 @@ int main(int argc, char** argv)
   AVATAR::Avatar* avatar = 
     AVATAR::LoadAvatar(avatar_file.c_str());
   assert((p != NULL) && (tracker != NULL) && (avatar != NULL));
+  tracker->_profiler.Enable(profile_p);
   cv::Mat im,draw; cvNamedWindow("test"); 
   cv::VideoCapture camera;
   if (camera_index == -1) {
@@ -368,6 +373,9 @@ int main(int argc, char** argv)
       animate_time = 0;
       frame = 0;
     }
-  }return 0;
+  }
+  if (profile_p)
+    tracker->_profiler.Print(std::cout);
+  return 0;
 }
 //==============================================================================
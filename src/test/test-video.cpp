@@ -0,0 +1,46 @@
+// CSIRO has filed various patents which cover the Software.
+
+// CSIRO grants to you a license to any patents granted for inventions
+// implemented by the Software for academic, research and non-commercial
+// use only.
+
+// CSIRO hereby reserves all rights to its inventions implemented by the
+// Software and any patents subsequently granted for those inventions
+// that are not expressly granted to you.  Should you wish to license the
+// patents relating to the Software for commercial use please contact
+// CSIRO IP & Licensing, Gautam Tendulkar (gautam.tendulkar@csiro.au) or
+// Nick Marsh (nick.marsh@csiro.au)
+
+// This software is provided under the CSIRO OPEN SOURCE LICENSE
+// (GPL2) which can be found in the LICENSE file located in the top
+// most directory of the source code.
+
+// Copyright CSIRO 2013
+
+#include <test/test-video.hpp>
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+
+//==============================================================================
+bool open_test_video(const std::string &video, cv::VideoCapture &camera)
+{
+  char* end = NULL;
+  long index = std::strtol(video.c_str(), &end, 10);
+  if (!video.empty() && (*end == '\0')) {
+    camera.open(int(index));
+  } else {
+    std::ifstream stream(video.c_str());
+    if (!stream.good()) {
+      std::cerr << "Video file does not exist." << std::endl;
+      return false;
+    }
+    camera.open(video);
+  }
+  if (!camera.isOpened()) {
+    std::cerr << "Failed to open video " << video << "." << std::endl;
+    return false;
+  }
+  return true;
+}
+//==============================================================================
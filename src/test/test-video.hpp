@@ -0,0 +1,31 @@
+// CSIRO has filed various patents which cover the Software.
+
+// CSIRO grants to you a license to any patents granted for inventions
+// implemented by the Software for academic, research and non-commercial
+// use only.
+
+// CSIRO hereby reserves all rights to its inventions implemented by the
+// Software and any patents subsequently granted for those inventions
+// that are not expressly granted to you.  Should you wish to license the
+// patents relating to the Software for commercial use please contact
+// CSIRO IP & Licensing, Gautam Tendulkar (gautam.tendulkar@csiro.au) or
+// Nick Marsh (nick.marsh@csiro.au)
+
+// This software is provided under the CSIRO OPEN SOURCE LICENSE
+// (GPL2) which can be found in the LICENSE file located in the top
+// most directory of the source code.
+
+// Copyright CSIRO 2013
+
+#ifndef _TEST_VIDEO_HPP_
+#define _TEST_VIDEO_HPP_
+
+#include <opencv/highgui.h>
+#include <string>
+
+// Opens the argument of a test program's --video option, a camera index
+// or the pathname of a video file. Prints why and returns false when it
+// cannot be opened.
+bool open_test_video(const std::string &video, cv::VideoCapture &camera);
+
+#endif
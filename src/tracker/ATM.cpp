@@ -70,6 +70,7 @@ void ATM::AllocMemory()
   vecx__.create(_warp.nPix(),1,CV_64F);
   vecy__.create(_warp.nPix(),1,CV_64F);
   vecw__.create(_warp.nPix(),1,CV_64F);
+  r__.create(_warp.nPix(),1,CV_64F);
   crop__.create(_warp.Height(),_warp.Width(),CV_8U);
   cropx__.create(_warp.Height(),_warp.Width(),CV_32F);
   cropy__.create(_warp.Height(),_warp.Width(),CV_32F);
@@ -164,8 +165,11 @@ int ATM::Update(cv::Mat &im,cv::Mat &s,
 void ATM::CalcJacob(cv::Mat &im,cv::Mat &s, cv::Mat &dxdp,
 		    cv::Mat &J,cv::Mat &vec)
 {
-  cv::Sobel(im,imx__,CV_32F,1,0,3); imx__ /= 8;
-  cv::Sobel(im,imy__,CV_32F,0,1,3); imy__ /= 8;
+  if(_frame)_frame->Gradients(_scale,imx__,imy__); //of im, once per frame
+  else{
+    cv::Sobel(im,imx__,CV_32F,1,0,3); imx__ /= 8;
+    cv::Sobel(im,imy__,CV_32F,0,1,3); imy__ /= 8;
+  }
   if((J.cols != dxdp.cols) || (J.rows != _warp.nPix()))
     J.create(_warp.nPix(),dxdp.cols,CV_64F);
   _warp.Crop(im,crop__,s); 
@@ -208,7 +212,8 @@ void ATM::BuildLinearSystem(cv::Mat &im,cv::Mat &s,
   }
   int N = 0; for(int i = 0; i < int(_T.size()); i++)N += int(_T[i].size());
   _warp.Crop(im,crop__,s); _warp.Vectorize(crop__,vec__);
-  cv::Mat e(N,1,CV_64F); double sum = 0.0; int k = 0;
+  if(e__.rows != N)e__.create(N,1,CV_64F);
+  cv::Mat &e = e__; double sum = 0.0; int k = 0;
   for(int i = 0; i < int(_T.size()); i++){
     for(int j = 0; j < int(_T[i].size()); j++,k++){
       double v = cv::norm(_T[i][j],vec__); 
@@ -228,12 +233,16 @@ void ATM::BuildLinearSystem(cv::Mat &im,cv::Mat &s,
   }
   e /= sum; vecw__ = cv::Scalar(0); k = 0;
   for(int i = 0; i < int(_T.size()); i++){
-    for(int j = 0; j < int(_T[i].size()); j++,k++)vecw__ += e.db(k,0)*_T[i][j];
+    for(int j = 0; j < int(_T[i].size()); j++,k++)
+      cv::scaleAdd(_T[i][j],e.db(k,0),vecw__,vecw__);
   }
   if(na__[idx] < 1){
-    this->CalcJacob(im,s,dxdp,J__,vec__);
-    H = J__.t()*J__; g = J__.t()*(vecw__-vec__); 
-  }else{Ha__[idx].copyTo(H); g = Ja__[idx].t()*(vecw__-vec__);}
-  return;
+    this->CalcJacob(im,s,dxdp,J__,vec__); cv::subtract(vecw__,vec__,r__);
+    H = cv::Scalar(0); AddJtJ(J__,1.0,H);
+    g = cv::Scalar(0); AddJtr(J__,r__,1.0,g);
+  }else{
+    cv::subtract(vecw__,vec__,r__); Ha__[idx].copyTo(H);
+    g = cv::Scalar(0); AddJtr(Ja__[idx],r__,1.0,g);
+  }return;
 }
 //=============================================================================
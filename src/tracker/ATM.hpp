@@ -21,6 +21,7 @@
 #define _TRACKER_ATM_h_
 #include <tracker/ShapeModel.hpp>
 #include <tracker/Warp.hpp>
+#include <tracker/FramePyramid.hpp>
 #include <vector>
 namespace FACETRACKER
 {
@@ -35,15 +36,17 @@ namespace FACETRACKER
     double _scale;                         /**< Scale of reference frame */
     std::vector<cv::Mat> _center;          /**< Centers of each pose     */
     std::vector<std::vector<cv::Mat> > _T; /**< Templates                */
+    FramePyramid* _frame;                  /**< Gradients of the image, 
+					      computed from it if NULL   */
 
-    ATM(){_init = false;}
+    ATM(){_init = false; _frame = NULL;}
     ATM(std::vector<cv::Mat> &center, //centers of each pose
 	cv::Mat &pose,                //pose of first shape
 	cv::Mat &shape,               //first shape
 	cv::Mat &im,                  //first image
 	cv::Mat &tri,                 //triangulation
 	const double scale=1){        //scale of reference frame
-      this->Init(center,pose,shape,im,tri,scale);
+      _frame = NULL; this->Init(center,pose,shape,im,tri,scale);
     }
     void 
     Init(std::vector<cv::Mat> &center, //centers of each pose
@@ -94,7 +97,7 @@ namespace FACETRACKER
 
   protected:
     cv::Mat imx__,imy__,vec__,vecx__,vecy__,crop__,cropx__,cropy__;
-    cv::Mat pixtri__,dWdx__,J__,vecw__;
+    cv::Mat pixtri__,dWdx__,J__,vecw__,r__,e__;
     std::vector<cv::Mat> Ja__,Ha__;
     std::vector<int> na__;
   };
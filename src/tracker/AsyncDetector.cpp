@@ -0,0 +1,94 @@
+// CSIRO has filed various patents which cover the Software. 
+
+// CSIRO grants to you a license to any patents granted for inventions
+// implemented by the Software for academic, research and non-commercial
+// use only.
+
+// CSIRO hereby reserves all rights to its inventions implemented by the
+// Software and any patents subsequently granted for those inventions
+// that are not expressly granted to you.  Should you wish to license the
+// patents relating to the Software for commercial use please contact
+// CSIRO IP & Licensing, Gautam Tendulkar (gautam.tendulkar@csiro.au) or
+// Nick Marsh (nick.marsh@csiro.au)
+
+// This software is provided under the CSIRO OPEN SOURCE LICENSE
+// (GPL2) which can be found in the LICENSE file located in the top
+// most directory of the source code.
+
+// Copyright CSIRO 2013
+
+#include <tracker/AsyncDetector.hpp>
+using namespace FACETRACKER;
+using namespace std;
+//===========================================================================
+AsyncDetector::AsyncDetector()
+{
+  this->Create();
+}
+//===========================================================================
+AsyncDetector::AsyncDetector(AsyncDetector const&)
+{
+  this->Create();
+}
+//===========================================================================
+AsyncDetector::~AsyncDetector()
+{
+  this->Stop();
+}
+//===========================================================================
+void AsyncDetector::Create()
+{
+  func_ = NULL; data_ = NULL; joinable_ = false; 
+  state_ = IDLE; gen_ = job_ = 0; return;
+}
+//===========================================================================
+bool AsyncDetector::Submit(cv::Mat &im,
+			   cv::Rect (*func)(cv::Mat &im,void* data),void* data)
+{
+  cv::AutoLock lock(lock_);
+  if(state_ != IDLE)return false;
+  if(joinable_){pthread_join(thread_,NULL); joinable_ = false;} //finished
+  func_ = func; data_ = data; im.copyTo(frame_); 
+  state_ = BUSY; job_ = gen_;
+  if(pthread_create(&thread_,NULL,&AsyncDetector::Main,this) != 0){
+    printf("ERROR(%s,%d) : cannot create detection thread\n",
+	   __FILE__,__LINE__); abort();
+  }joinable_ = true; return true;
+}
+//===========================================================================
+int AsyncDetector::Poll(cv::Rect &rect)
+{
+  cv::AutoLock lock(lock_); int state = state_;
+  if(state_ == DONE){rect = rect_; state_ = IDLE;}
+  return state;
+}
+//===========================================================================
+void AsyncDetector::Cancel()
+{
+  cv::AutoLock lock(lock_); gen_++;
+  if(state_ == DONE)state_ = IDLE;
+  return;
+}
+//===========================================================================
+void AsyncDetector::Stop()
+{
+  lock_.lock(); gen_++; bool join = joinable_; joinable_ = false;
+  lock_.unlock();
+  if(join)pthread_join(thread_,NULL); 
+  cv::AutoLock lock(lock_); state_ = IDLE; frame_.release(); return;
+}
+//===========================================================================
+void AsyncDetector::Run()
+{
+  //func_, data_ and frame_ are not changed while a detection is in flight
+  cv::Rect R = func_(frame_,data_);
+  cv::AutoLock lock(lock_);
+  if(job_ == gen_){rect_ = R; state_ = DONE;} else state_ = IDLE;
+  return;
+}
+//===========================================================================
+void* AsyncDetector::Main(void* self)
+{
+  static_cast<AsyncDetector*>(self)->Run(); return NULL;
+}
+//===========================================================================
@@ -0,0 +1,62 @@
+// CSIRO has filed various patents which cover the Software. 
+
+// CSIRO grants to you a license to any patents granted for inventions
+// implemented by the Software for academic, research and non-commercial
+// use only.
+
+// CSIRO hereby reserves all rights to its inventions implemented by the
+// Software and any patents subsequently granted for those inventions
+// that are not expressly granted to you.  Should you wish to license the
+// patents relating to the Software for commercial use please contact
+// CSIRO IP & Licensing, Gautam Tendulkar (gautam.tendulkar@csiro.au) or
+// Nick Marsh (nick.marsh@csiro.au)
+
+// This software is provided under the CSIRO OPEN SOURCE LICENSE
+// (GPL2) which can be found in the LICENSE file located in the top
+// most directory of the source code.
+
+// Copyright CSIRO 2013
+
+#ifndef _TRACKER_AsyncDetector_h_
+#define _TRACKER_AsyncDetector_h_
+#include <tracker/IO.hpp>
+#include <pthread.h>
+namespace FACETRACKER
+{
+  //===========================================================================
+  /** 
+      Runs a face detector on a helper thread. A frame handed to Submit() is
+      copied and detected in the background, and the result is collected 
+      later with Poll(), so the caller never waits for the detector. Only
+      one detection is in flight at a time, each on a thread started by
+      Submit() and joined by the next Submit() or by Stop(). Copies start
+      idle and do not share the thread.
+  */
+  class AsyncDetector{
+  public:
+    enum{IDLE = 0,BUSY,DONE};
+
+    AsyncDetector();
+    AsyncDetector(AsyncDetector const&);
+    AsyncDetector& operator=(AsyncDetector const&){return *this;}
+    ~AsyncDetector();
+    bool                     //false if a detection is already in flight
+    Submit(cv::Mat &im,      //grayscale frame to detect on
+	   cv::Rect (*func)(cv::Mat &im,void* data), //detector
+	   void* data);      //passed to func
+    int                      //IDLE, BUSY or DONE
+    Poll(cv::Rect &rect);    //result when DONE, which resets to IDLE
+    void Cancel();           //discard the result of the detection in flight
+    void Stop();             //cancel and join the helper thread
+  private:
+    cv::Rect (*func_)(cv::Mat &im,void* data); void* data_;
+    pthread_t thread_; bool joinable_; cv::Mutex lock_;
+    int state_,gen_,job_; cv::Mat frame_; cv::Rect rect_;
+
+    void Create();
+    void Run();
+    static void* Main(void* self);
+  };
+  //===========================================================================
+}
+#endif
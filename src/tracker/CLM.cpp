@@ -18,6 +18,7 @@
 // Copyright CSIRO 2013
 
 #include "tracker/CLM.hpp"
+#include <tracker/ThreadPool.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 #include <iostream>
 #define it at<int>
@@ -31,34 +32,29 @@ void FACETRACKER::CalcSimT(cv::Mat &src,cv::Mat &dst,
 {
   assert((src.type() == CV_64F) && (dst.type() == CV_64F) && 
 	 (src.rows == dst.rows) && (src.cols == dst.cols) && (src.cols == 1));
-  int i,n = src.rows/2;
-  cv::Mat H(4,4,CV_64F,cv::Scalar(0));
-  cv::Mat g(4,1,CV_64F,cv::Scalar(0));
-  cv::Mat p(4,1,CV_64F);
+  int i,n = src.rows/2; double xx = 0,sx = 0,sy = 0,g0 = 0,g1 = 0,gx = 0,gy = 0;
   cv::MatIterator_<double> ptr1x = src.begin<double>();
   cv::MatIterator_<double> ptr1y = src.begin<double>()+n;
   cv::MatIterator_<double> ptr2x = dst.begin<double>();
   cv::MatIterator_<double> ptr2y = dst.begin<double>()+n;
   for(i = 0; i < n; i++,++ptr1x,++ptr1y,++ptr2x,++ptr2y){
-    H.db(0,0) += SQR(*ptr1x) + SQR(*ptr1y);
-    H.db(0,2) += *ptr1x; H.db(0,3) += *ptr1y;
-    g.db(0,0) += (*ptr1x)*(*ptr2x) + (*ptr1y)*(*ptr2y);
-    g.db(1,0) += (*ptr1x)*(*ptr2y) - (*ptr1y)*(*ptr2x);
-    g.db(2,0) += *ptr2x; g.db(3,0) += *ptr2y;
+    xx += SQR(*ptr1x) + SQR(*ptr1y); sx += *ptr1x; sy += *ptr1y;
+    g0 += (*ptr1x)*(*ptr2x) + (*ptr1y)*(*ptr2y);
+    g1 += (*ptr1x)*(*ptr2y) - (*ptr1y)*(*ptr2x);
+    gx += *ptr2x; gy += *ptr2y;
   }
-  H.db(1,1) = H.db(0,0); H.db(1,2) = H.db(2,1) = -1.0*(H.db(3,0) = H.db(0,3));
-  H.db(1,3) = H.db(3,1) = H.db(2,0) = H.db(0,2); H.db(2,2) = H.db(3,3) = n;
-	cv::solve(H,g,p,cv::DECOMP_CHOLESKY);
-  a = p.db(0,0); b = p.db(1,0); tx = p.db(2,0); ty = p.db(3,0); return;
+  //normal equations with the translation eliminated
+  double d = xx - (sx*sx + sy*sy)/n;
+  a = (g0 - (sx*gx + sy*gy)/n)/d; b = (g1 - (sx*gy - sy*gx)/n)/d;
+  tx = (gx - sx*a + sy*b)/n; ty = (gy - sy*a - sx*b)/n; return;
 }
 //=============================================================================
 void FACETRACKER::invSimT(double a1,double b1,double tx1,double ty1,
 			  double& a2,double& b2,double& tx2,double& ty2)
 {
-  cv::Mat M = (cv::Mat_<double>(2,2) << a1, -b1, b1, a1);
-	cv::Mat N = M.inv(cv::DECOMP_SVD); a2 = N.db(0,0); b2 = N.db(1,0);
-  tx2 = -1.0*(N.db(0,0)*tx1 + N.db(0,1)*ty1);
-  ty2 = -1.0*(N.db(1,0)*tx1 + N.db(1,1)*ty1); return;
+  double d = a1*a1 + b1*b1; a2 = a1/d; b2 = -b1/d;
+  tx2 = -1.0*(a2*tx1 - b2*ty1);
+  ty2 = -1.0*(b2*tx1 + a2*ty1); return;
 }
 //=============================================================================
 void FACETRACKER::SimT(cv::Mat &s,double a,double b,double tx,double ty)
@@ -111,6 +107,49 @@ CLM& CLM::operator= (CLM const& rhs)
   }return *this;
 }
 //=============================================================================
+void CLM::SetPrecision(int type)
+{
+  if((type != CV_32F) && (type != CV_64F)){
+    printf("ERROR(%s,%d): Unsupported precision %d\n",
+	   __FILE__,__LINE__,type); abort();
+  }
+  for(size_t i = 0; i < _detectorsNCC.size(); i++)_detectorsNCC[i]._type = type;
+  _pdm.SetPrecision(type); return;
+}
+//=============================================================================
+void CLM::Share(CLM const& rhs)
+{
+  _pdm.Share(rhs._pdm);
+  _refs = rhs._refs;
+  _kWidth = rhs._kWidth;
+  _cent = rhs._cent;
+  _visi.resize(rhs._visi.size());
+  _patch.resize(rhs._patch.size());
+  _detectorsNCC.resize(rhs._detectorsNCC.size());
+  for(size_t i = 0; i < rhs._patch.size(); i++){
+    _visi[i] = rhs._visi[i].clone(); //overwritten when tracking with priors
+    _patch[i].resize(rhs._patch[i].size());
+    for(size_t j = 0; j < rhs._patch[i].size(); j++)
+      _patch[i][j].Share(rhs._patch[i][j]);
+  }
+  for(size_t i = 0; i < rhs._detectorsNCC.size(); i++)
+    _detectorsNCC[i].Share(rhs._detectorsNCC[i]);
+  _plocal.create(_pdm.nModes(),1,CV_64F);
+  _pglobl.create(6,1,CV_64F);
+  cshape_.create(2*_pdm.nPoints(),1,CV_64F);
+  bshape_.create(2*_pdm.nPoints(),1,CV_64F);
+  oshape_.create(2*_pdm.nPoints(),1,CV_64F);
+  ms_.create(2*_pdm.nPoints(),1,CV_64F);
+  u_.create(6+_pdm.nModes(),1,CV_64F);
+  g_.create(6+_pdm.nModes(),1,CV_64F);
+  J_.create(2*_pdm.nPoints(),6+_pdm.nModes(),CV_64F);
+  H_.create(6+_pdm.nModes(),6+_pdm.nModes(),CV_64F);
+  prob_.resize(_pdm.nPoints());
+  pmem_.resize(_pdm.nPoints());
+  wmem_.resize(_pdm.nPoints());
+  return;
+}
+//=============================================================================
 void CLM::Init(PDM3D &s,cv::Mat &r, std::vector<cv::Mat> &c,
 	       std::vector<cv::Mat> &v,std::vector<std::vector<MPatch> > &p)
 {
@@ -229,6 +268,7 @@ void CLM::Read(ifstream &s,bool readType)
 
     _detectorsNCC.at(i)._patch = _patch[i];
     _detectorsNCC.at(i).setReferenceShape(_refs);
+    _detectorsNCC.at(i).Pack();
   }
   _plocal.create(_pdm.nModes(),1,CV_64F);
   _pglobl.create(6,1,CV_64F);
@@ -246,7 +286,7 @@ void CLM::Read(ifstream &s,bool readType)
   return;
 }
 //=============================================================================
-void CLM::ReadBinary(ifstream &s,bool readType)
+void CLM::ReadBinary(istream &s,bool readType)
 {
   if (readType) {
     int type;
@@ -278,6 +318,7 @@ void CLM::ReadBinary(ifstream &s,bool readType)
     }
     _detectorsNCC.at(i)._patch = _patch[i]; //.setPatchExperts(_patch[i]);
     _detectorsNCC.at(i).setReferenceShape(_refs);
+    _detectorsNCC.at(i).Pack();
   }
   
   _plocal.create(_pdm.nModes(),1,CV_64F);
@@ -326,15 +367,27 @@ void CLM::Fit(cv::Mat& im, std::vector<int> &wSize,
     idx = this->GetViewIdx();
 	
 	cv::Size wsz = cv::Size(wSize[witer], wSize[witer]);
-    _detectorsNCC.at(idx).response(im, cshape_,
+    {
+      PROFILE_STAGE(_profiler,RESPONSE);
+      _detectorsNCC.at(idx).response(im, cshape_,
 								   wsz, _visi[idx]);
-    prob_ = _detectorsNCC.at(idx).getResponsesForRefShape();
+      prob_ = _detectorsNCC.at(idx).prob_;
+    }
 	
     SimT(cshape_,a2,b2,tx2,ty2);
     _pdm.ApplySimT(a2,b2,tx2,ty2,_pglobl);
     cshape_.copyTo(bshape_);
-    this->Optimize(idx,wSize[witer],nIter,fTol,clamp,1);
-    this->Optimize(idx,wSize[witer],nIter,fTol,clamp,0);
+    int iter;
+    {
+      PROFILE_STAGE(_profiler,RIGID);
+      iter = this->Optimize(idx,wSize[witer],nIter,fTol,clamp,1);
+    }
+    {
+      PROFILE_STAGE(_profiler,NONRIGID);
+      iter += this->Optimize(idx,wSize[witer],nIter,fTol,clamp,0);
+    }
+    PROFILE_COUNT(_profiler,ITERATIONS,iter);
+    PROFILE_COUNT(_profiler,UNUSED,2*nIter - iter);
     _pdm.ApplySimT(a1,b1,tx1,ty1,_pglobl);
   }return;
 }
@@ -385,6 +438,34 @@ void CLM::Fit(cv::Mat& im, std::vector<int> &wSize,
 //  }return;
 //}
 //=============================================================================
+//image locations of the pixels of each landmark's response map
+struct LocationBody : public ParallelBody{
+  std::vector<cv::Mat> &prob,&xloc,&yloc; cv::Mat &visi,&shape; double a1,b1;
+  LocationBody(std::vector<cv::Mat> &p,std::vector<cv::Mat> &x,
+	       std::vector<cv::Mat> &y,cv::Mat &v,cv::Mat &s,double a,double b)
+    : prob(p),xloc(x),yloc(y),visi(v),shape(s),a1(a),b1(b){;}
+  void operator()(int begin,int end){
+    int n = shape.rows/2;
+    for(int i = begin; i < end; i++){
+      cv::Size wsz = prob[i].size();
+      if(visi.rows == n){if(visi.it(i,0) == 0)continue;}
+      xloc[i].create(wsz,CV_64F);
+      yloc[i].create(wsz,CV_64F);
+      double tx = shape.db(i,0), ty = shape.db(i+n,0);
+      cv::MatIterator_<double> px = xloc[i].begin<double>();
+      cv::MatIterator_<double> py = yloc[i].begin<double>();
+      for(int y = 0; y < wsz.height; y++){
+	double vy = y-(wsz.height-1)/2;
+	for(int x = 0; x < wsz.width; x++){
+	  double vx = x-(wsz.width-1)/2;
+	  *px++ = a1*vx - b1*vy + tx;
+	  *py++ = b1*vx + a1*vy + ty;
+	}
+      }
+    }return;
+  }
+};
+//=============================================================================
 void CLM::FitPrior(cv::Mat& im, std::vector<int> &wSize,
 		   int nIter,double clamp,double fTol,double lambda,
 		   void (*pfunc)(cv::Mat &im,cv::Mat &s, cv::Mat &dxdp,
@@ -406,53 +487,113 @@ void CLM::FitPrior(cv::Mat& im, std::vector<int> &wSize,
     //std::cout << "with Prior: "<< idx << std::endl;
     cv::Size wsz = cv::Size(wSize[witer], wSize[witer]);
     //compute patch responses in reference frame
-    _detectorsNCC[idx].response(im, cshape_, wsz, _visi[idx]);
-    prob_ = _detectorsNCC[idx].getResponsesForRefShape(_refs);
+    {
+      PROFILE_STAGE(_profiler,RESPONSE);
+      _detectorsNCC[idx].response(im, cshape_, wsz, _visi[idx]);
+      _detectorsNCC[idx].getResponsesForRefShape(_refs,prob_);
+    }
 	
     //transform landmark candidates to image frame
-    std::vector<cv::Mat> xloc(n),yloc(n);
+    xloc_.resize(n); yloc_.resize(n);
     //   int wsize = wSize[witer];
-#ifdef _OPENMP
-#pragma omp parallel for
-#endif
-    for(int i = 0; i < n; i++){
-      cv::Size wsz = prob_[i].size();
-      if(_visi[idx].rows == n){if(_visi[idx].it(i,0) == 0)continue;}
-      xloc[i].create(wsz,CV_64F);
-      yloc[i].create(wsz,CV_64F);
-      double tx = cshape_.db(i,0), ty = cshape_.db(i+n,0);
-      cv::MatIterator_<double> px = xloc[i].begin<double>();
-      cv::MatIterator_<double> py = yloc[i].begin<double>();
-      for(int y = 0; y < wsz.height; y++){
-		double vy = y-(wsz.height-1)/2;
-		for(int x = 0; x < wsz.width; x++){
-		  double vx = x-(wsz.width-1)/2;
-		  *px++ = a1*vx - b1*vy + tx;
-		  *py++ = b1*vx + a1*vy + ty;
-		}
-      }
+    {
+      LocationBody body(prob_,xloc_,yloc_,_visi[idx],cshape_,a1,b1);
+      ParallelFor(0,n,body);
     }
     //optimise
     cshape_.copyTo(bshape_);
     //this->OptimizePrior(xloc,yloc,idx,wsize,nIter,fTol,clamp,1,lambda,im,
     //			pfunc,data);
-    this->OptimizePrior(xloc,yloc,idx,wSize[witer],nIter,fTol,clamp,0,lambda,im,
-						pfunc,data);
+    PROFILE_STAGE(_profiler,NONRIGID);
+    int iter = this->OptimizePrior(xloc_,yloc_,idx,wSize[witer],nIter,fTol,
+				   clamp,0,lambda,im,pfunc,data);
+    PROFILE_COUNT(_profiler,ITERATIONS,iter);
+    PROFILE_COUNT(_profiler,UNUSED,nIter - iter);
   }return;
 }
 //=============================================================================
-void CLM::OptimizePrior(std::vector<cv::Mat> &xloc,
-			std::vector<cv::Mat> &yloc,
-			int idx,int // wSize
-			,int nIter,
-			double fTol,double clamp,bool rigid,
-			double lambda,cv::Mat &im,
-			void (*pfunc)(cv::Mat &im,cv::Mat &s, cv::Mat &dxdp,
-				      cv::Mat &H,cv::Mat &g,void* data),
-			void* data)
+//kernel weighted mean of a response map about (dx,dy), minus (dx,dy).
+//kx and ky hold prob.cols and prob.rows kernel values on return.
+template <typename T> static void 
+MeanShift(const cv::Mat &prob,const KDEKernel &K,double dx,double dy,
+	  T* kx,T* ky,double &ux,double &uy)
+{
+  int ii,jj,w = prob.cols,h = prob.rows; T v,vs,vx;
+  double mx=0.0,my=0.0,sum=0.0;
+  for(jj = 0; jj < w; jj++)kx[jj] = K(dx-jj);
+  for(ii = 0; ii < h; ii++)ky[ii] = K(dy-ii);
+  for(ii = 0; ii < h; ii++){
+    const T* p = prob.ptr<T>(ii); vs = 0; vx = 0;
+    for(jj = 0; jj < w; jj++){
+      v = p[jj]*kx[jj]; vs += v; vx += v*jj;
+    }
+    sum += ky[ii]*vs; mx += ky[ii]*vx; my += ky[ii]*vs*ii;
+  }
+  ux = mx/sum - dx; uy = my/sum - dy; return;
+}
+//=============================================================================
+//as above, about (dx,dy) in the image with the map's pixel locations given
+template <typename T> static void 
+MeanShift(const cv::Mat &prob,const cv::Mat &xloc,const cv::Mat &yloc,
+	  double dx,double dy,double sigma,double &ux,double &uy)
+{
+  int ii,jj,w = prob.cols,h = prob.rows; 
+  double v,lx,ly,mx=0.0,my=0.0,sum=0.0;
+  for(ii = 0; ii < h; ii++){
+    const T* p = prob.ptr<T>(ii); 
+    const double* px = xloc.ptr<double>(ii); 
+    const double* py = yloc.ptr<double>(ii);
+    for(jj = 0; jj < w; jj++){
+      lx = px[jj] - dx; ly = py[jj] - dy;
+      v = p[jj]*exp(-0.5*(lx*lx+ly*ly)/sigma);
+      sum += v;  mx += v*lx;  my += v*ly;
+    }
+  }
+  ux = mx/sum; uy = my/sum; return;
+}
+//=============================================================================
+//mean-shift of each landmark over its response map located in the image
+struct PriorShiftBody : public ParallelBody{
+  std::vector<cv::Mat> &prob,&xloc,&yloc; cv::Mat &visi,&shape,&J,&ms;
+  double sigma;
+  PriorShiftBody(std::vector<cv::Mat> &p,std::vector<cv::Mat> &x,
+		 std::vector<cv::Mat> &y,cv::Mat &v,cv::Mat &s,cv::Mat &j,
+		 cv::Mat &m,double sig)
+    : prob(p),xloc(x),yloc(y),visi(v),shape(s),J(j),ms(m),sigma(sig){;}
+  void operator()(int begin,int end){
+    int n = shape.rows/2;
+    for(int i = begin; i < end; i++){
+      bool discard = false;
+      if(visi.rows == n){if(visi.it(i,0) == 0)discard = true;}
+      if(prob[i].empty())discard = true;
+      if(discard){
+	cv::Mat Jx = J.row(i  ); Jx = cvScalar(0);
+	cv::Mat Jy = J.row(i+n); Jy = cvScalar(0);
+	ms.db(i,0) = 0.0; ms.db(i+n,0) = 0.0; continue;
+      }
+      double dx = shape.db(i,0),dy = shape.db(i+n,0);
+      double sigmai = sigma*prob[i].total();
+      double &ux = ms.db(i,0),&uy = ms.db(i+n,0);
+      if(prob[i].type() == CV_32F)
+	MeanShift<float>(prob[i],xloc[i],yloc[i],dx,dy,sigmai,ux,uy);
+      else
+	MeanShift<double>(prob[i],xloc[i],yloc[i],dx,dy,sigmai,ux,uy);
+    }return;
+  }
+};
+//=============================================================================
+int CLM::OptimizePrior(std::vector<cv::Mat> &xloc,
+		       std::vector<cv::Mat> &yloc,
+		       int idx,int // wSize
+		       ,int nIter,
+		       double fTol,double clamp,bool rigid,
+		       double lambda,cv::Mat &im,
+		       void (*pfunc)(cv::Mat &im,cv::Mat &s, cv::Mat &dxdp,
+				     cv::Mat &H,cv::Mat &g,void* data),
+		       void* data)
 {
-  int i,m=_pdm.nModes(),n=_pdm.nPoints();  
-  double var,sigma=_pglobl.db(0,0)*_pglobl.db(0,0)/_kWidth;
+  int iter,n=_pdm.nPoints();  
+  double sigma=_pglobl.db(0,0)*_pglobl.db(0,0)/_kWidth;
   cv::Mat u,g,J,H; 
   if(rigid){
     u = u_(cv::Rect(0,0,1,6));   g = g_(cv::Rect(0,0,1,6)); 
@@ -466,7 +607,7 @@ void CLM::OptimizePrior(std::vector<cv::Mat> &xloc,
 	}
   }
   // std::cout<<"sigma: " << sigma << std::endl;
-  for(int iter = 0; iter < nIter; iter++){
+  for(iter = 0; iter < nIter; iter++){
     _pdm.CalcShape2D(cshape_,_plocal,_pglobl);
     if(iter > 0){
 	  if(cv::norm(cshape_,oshape_) < fTol)
@@ -478,60 +619,17 @@ void CLM::OptimizePrior(std::vector<cv::Mat> &xloc,
     pfunc(im,cshape_,J,H,g,data);
 	H *= lambda; g *= lambda;
 	
-#ifdef _OPENMP
-#pragma omp parallel for
-#endif
-	for(i = 0; i < n; i++){
-	  bool discard = false;
-	  if(_visi[idx].rows == n){
-		if(_visi[idx].it(i,0) == 0){
-		  discard = true;
-		}
-	  }
-	  if (prob_[i].empty()) {
-		discard = true;
-	  }
-	  if(discard){
-		cv::Mat Jx = J.row(i  ); Jx = cvScalar(0);
-		cv::Mat Jy = J.row(i+n); Jy = cvScalar(0);
-		ms_.db(i,0) = 0.0; ms_.db(i+n,0) = 0.0; continue;
-	  }
-	  double dx = cshape_.db(i,0),dy = cshape_.db(i+n,0);
-	  cv::Size wsz = prob_[i].size();
-	  double sigmai = sigma*wsz.width*wsz.height;
-	  int ii,jj; double v,vx,vy,lx,ly,mx=0.0,my=0.0,sum=0.0;
-	  cv::MatIterator_<double> p = prob_[i].begin<double>();
-	  cv::MatIterator_<double> px = xloc[i].begin<double>();
-	  cv::MatIterator_<double> py = yloc[i].begin<double>();
-	  /*
-	   cv::Mat vx = (xloc - dx);
-	   cv::Mat vy = (yloc - dy);
-	   cv::Mat v = prob * cv::exp(-.5*(vx.mul(vx)+vy.mul(vy))/sigma);
-	   sum = cv::sum(v); mx = cv::sum(v.mul(vx)); my = cv::sum(v.mul(vy));
-	   ms._db(i,0) = mx/sum; ms_.db(i+n, 0) = my/sum;
-	   */
-      for(ii = 0; ii < wsz.height; ii++){
-      	for(jj = 0; jj < wsz.width; jj++){
-      	  lx = *px++ - dx; vx = lx*lx;
-      	  ly = *py++ - dy; vy = ly*ly;
-      	  v = *p++; v *= exp(-0.5*(vx+vy)/(sigmai));
-      	  sum += v;  mx += v*lx;  my += v*ly;
-      	}
-      }
-      ms_.db(i,0) = mx/sum; ms_.db(i+n,0) = my/sum;
+	{
+	  PriorShiftBody body(prob_,xloc,yloc,_visi[idx],cshape_,J,ms_,sigma);
+	  ParallelFor(0,n,body);
 	}
-	g += (1.0-lambda)*(J.t()*ms_); H += (1.0-lambda)*(J.t()*J);
+	AddJtr(J,ms_,1.0-lambda,g); AddJtJ(J,1.0-lambda,H);
 	
-    if(!rigid){
-      for(i = 0; i < m; i++){
-		var = (1.0-lambda)*0.5*sigma/_pdm._E.db(0,i);
-		H.db(6+i,6+i) += var; g.db(6+i,0) -= var*_plocal.db(i,0);
-      }
-    }
-	u_ = cvScalar(0); cv::solve(H,g,u,cv::DECOMP_CHOLESKY);
+    if(!rigid)AddShapePrior(_pdm._E,_plocal,(1.0-lambda)*0.5*sigma,H,g);
+	u_ = cvScalar(0); CholSolve(H,g,u);
     _pdm.CalcReferenceUpdate(u_,_plocal,_pglobl);
     if(!rigid)_pdm.Clamp(_plocal,clamp);
-  }return;
+  }return iter;
 }
 ////=============================================================================
 //void CLM::OptimizeFwdAdd(std::vector<cv::Mat> &xloc,
@@ -693,11 +791,46 @@ void CLM::OptimizePrior(std::vector<cv::Mat> &xloc,
 //  }return;
 //}
 //=============================================================================
-void CLM::Optimize(int idx,int wSize,int nIter,
-		   double fTol,double clamp,bool rigid)
+//kernel mean-shift of each landmark over its response map
+struct ShiftBody : public ParallelBody{
+  std::vector<cv::Mat> &prob; std::vector<KDEKernel> &kern; 
+  std::vector<int> &kidx; cv::Mat &visi,&shape,&bshape,&J,&ms,&kmem; int wSize;
+  ShiftBody(std::vector<cv::Mat> &p,std::vector<KDEKernel> &k,
+	    std::vector<int> &ki,cv::Mat &v,cv::Mat &s,cv::Mat &bs,cv::Mat &j,
+	    cv::Mat &m,cv::Mat &km,int ws)
+    : prob(p),kern(k),kidx(ki),visi(v),shape(s),bshape(bs),J(j),ms(m),
+      kmem(km),wSize(ws){;}
+  void operator()(int begin,int end){
+    int n = shape.rows/2;
+    for(int i = begin; i < end; i++){
+      bool discard = false;
+      if(visi.rows == n){if(visi.it(i,0) == 0)discard = true;}
+      if(prob[i].empty())discard = true;
+      if(discard){
+	cv::Mat Jx = J.row(i  ); Jx = cvScalar(0);
+	cv::Mat Jy = J.row(i+n); Jy = cvScalar(0);
+	ms.db(i,0) = 0.0; ms.db(i+n,0) = 0.0; continue;
+      }
+      double dx = shape.db(i  ,0) - bshape.db(i  ,0) + (wSize-1)/2;
+      double dy = shape.db(i+n,0) - bshape.db(i+n,0) + (wSize-1)/2;
+      const KDEKernel &K = kern[kidx[i]]; int w = prob[i].cols;
+      double &ux = ms.db(i,0),&uy = ms.db(i+n,0);
+      if(prob[i].type() == CV_32F){
+	float* kx = reinterpret_cast<float*>(kmem.ptr<double>(i));
+	MeanShift<float>(prob[i],K,dx,dy,kx,kx+w,ux,uy);
+      }else{
+	double* kx = kmem.ptr<double>(i);
+	MeanShift<double>(prob[i],K,dx,dy,kx,kx+w,ux,uy);
+      }
+    }return;
+  }
+};
+//=============================================================================
+int CLM::Optimize(int idx,int wSize,int nIter,
+		  double fTol,double clamp,bool rigid)
 {
-  int m=_pdm.nModes(),n=_pdm.nPoints();  
-  double var,sigma=(wSize*wSize)/_kWidth; cv::Mat u,g,J,H;
+  int iter,n=_pdm.nPoints();  
+  double sigma=(wSize*wSize)/_kWidth; cv::Mat u,g,J,H;
   if(rigid){
     u = u_(cv::Rect(0,0,1,6));   g = g_(cv::Rect(0,0,1,6)); 
     J = J_(cv::Rect(0,0,6,2*n)); H = H_(cv::Rect(0,0,6,6));
@@ -709,55 +842,53 @@ void CLM::Optimize(int idx,int wSize,int nIter,
 	}
   }
   if(sigma ==0) sigma = wSize*wSize/_kWidth;
+
+  //look up the tabulated kernel of each response window
+  int kcols = 0; kidx_.resize(n);
+  for(int i = 0; i < n; i++){
+    if(prob_[i].empty()){kidx_[i] = -1; continue;}
+    cv::Size wsz = prob_[i].size();
+    kidx_[i] = this->Kernel(std::max(wsz.width,wsz.height),
+			    wsz.width*wsz.height/_kWidth);
+    kcols = std::max(kcols,wsz.width+wsz.height);
+  }
+  if(kmem_.rows < n || kmem_.cols < kcols)kmem_.create(n,kcols,CV_64F);
   
-  for(int iter = 0; iter < nIter; iter++){
+  for(iter = 0; iter < nIter; iter++){
     _pdm.CalcShape2D(cshape_,_plocal,_pglobl);
     if(iter > 0){if(cv::norm(cshape_,oshape_) < fTol)break;}
     cshape_.copyTo(oshape_);
     if(rigid)_pdm.CalcRigidJacob(_plocal,_pglobl,J);
     else     _pdm.CalcJacob(_plocal,_pglobl,J);
-#ifdef _OPENMP
-#pragma omp parallel for
-#endif
-    for(int i = 0; i < n; i++){
-	  bool discard = false;
-      if(_visi[idx].rows == n){
-		if(_visi[idx].it(i,0) == 0){
-		  discard = true;
-		}
-      }
-	  if(prob_[i].empty()) discard = true;
-	  if(discard){
-		cv::Mat Jx = J.row(i  ); Jx = cvScalar(0);
-		cv::Mat Jy = J.row(i+n); Jy = cvScalar(0);
-		ms_.db(i,0) = 0.0; ms_.db(i+n,0) = 0.0; continue;
-	  }
-      double dx = cshape_.db(i  ,0) - bshape_.db(i  ,0) + (wSize-1)/2;
-      double dy = cshape_.db(i+n,0) - bshape_.db(i+n,0) + (wSize-1)/2;
-	  cv::Size wsz = prob_[i].size();
-      double sigmai = wsz.width*wsz.height/_kWidth;
-      int ii,jj; double v,vx,vy,mx=0.0,my=0.0,sum=0.0;      
-      cv::MatIterator_<double> p = prob_[i].begin<double>();
-      for(ii = 0; ii < wsz.height; ii++){
-		vx = (dy-ii)*(dy-ii);
-		for(jj = 0; jj < wsz.width; jj++){
-		  vy = (dx-jj)*(dx-jj);
-		  v = *p++; v *= exp(-0.5*(vx+vy)/sigmai);
-		  sum += v;  mx += v*jj;  my += v*ii;
-		}
-	}
-      ms_.db(i,0) = mx/sum - dx; ms_.db(i+n,0) = my/sum - dy;
+    {
+      ShiftBody body(prob_,kern_,kidx_,_visi[idx],cshape_,bshape_,J,ms_,kmem_,
+		     wSize);
+      ParallelFor(0,n,body);
     }
-    g = J.t()*ms_; H = J.t()*J;
-    if(!rigid){
-      for(int i = 0; i < m; i++){
-		var = 0.5*sigma/_pdm._E.db(0,i);
-		H.db(6+i,6+i) += var; g.db(6+i,0) -= var*_plocal.db(i,0);
-      }
-    }
-	  u_ = cvScalar(0); cv::solve(H,g,u,cv::DECOMP_CHOLESKY);
+    g = cvScalar(0); AddJtr(J,ms_,1.0,g); H = cvScalar(0); AddJtJ(J,1.0,H);
+    if(!rigid)AddShapePrior(_pdm._E,_plocal,0.5*sigma,H,g);
+	  u_ = cvScalar(0); CholSolve(H,g,u);
     _pdm.CalcReferenceUpdate(u_,_plocal,_pglobl);
     if(!rigid)_pdm.Clamp(_plocal,clamp);
+  }return iter;
+}
+//==============================================================================
+//==============================================================================
+void KDEKernel::Init(int size,double sigma)
+{
+  _size = size; _sigma = sigma; _table.create(1,2*size*RESOLUTION+2,CV_64F);
+  double* k = _table.ptr<double>(0);
+  for(int i = 0; i < _table.cols; i++){
+    double d = double(i)/RESOLUTION; k[i] = exp(-0.5*d*d/sigma);
   }return;
 }
 //==============================================================================
+int CLM::Kernel(int size,double sigma)
+{
+  for(size_t i = 0; i < kern_.size(); i++){
+    if(kern_[i].Matches(size,sigma))return i;
+  }
+  kern_.push_back(KDEKernel()); kern_.back().Init(size,sigma); 
+  return kern_.size()-1;
+}
+//==============================================================================
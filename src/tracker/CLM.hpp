@@ -22,6 +22,7 @@
 #include <tracker/ShapeModel.hpp>
 #include <tracker/Patch.hpp>
 #include <tracker/Detector.hpp>
+#include <tracker/Profiler.hpp>
 #include <vector>
 namespace FACETRACKER
 {
@@ -33,6 +34,30 @@ namespace FACETRACKER
 	       double& a2,double& b2,double& tx2,double& ty2);
   void SimT(cv::Mat &s,double a,double b,double tx,double ty);
   //===========================================================================
+  /** 
+      Gaussian kernel of the CLM mean-shift, exp(-0.5*d*d/sigma), tabulated 
+      at sub-pixel offsets for one response window size and kernel width
+  */
+  class KDEKernel{
+  public:
+    enum{RESOLUTION = 16};   /**< table samples per pixel      */
+    int     _size;           /**< largest window side          */
+    double  _sigma;          /**< kernel variance              */
+    cv::Mat _table;          /**< kernel at d = i/RESOLUTION   */
+
+    KDEKernel(){_size = 0; _sigma = 0.0;}
+    void Init(int size,double sigma);
+    inline bool Matches(int size,double sigma) const{
+      return (_size == size) && (_sigma == sigma);
+    }
+    inline double operator()(double d) const{
+      const double* k = _table.ptr<double>(0); 
+      double x = fabs(d)*RESOLUTION; int i = (int)x;
+      if(i >= _table.cols-1)return k[_table.cols-1];
+      return k[i] + (x-i)*(k[i+1]-k[i]);
+    }
+  };
+  //===========================================================================
   /** 
       A Constrained Local Model
   */
@@ -45,21 +70,25 @@ namespace FACETRACKER
     std::vector<cv::Mat>              _cent;  /**< Centers/view (Euler)     */
     std::vector<cv::Mat>              _visi;  /**< Visibility for each view */
     std::vector<std::vector<MPatch> > _patch; /**< Patches/point/view       */
+    Profiler*                         _profiler;/**< Stage timings or NULL  */
 
-    CLM(){;}
-    CLM(const char* fname){this->Load(fname);}
+    CLM(){_profiler = NULL;}
+    CLM(const char* fname){_profiler = NULL; this->Load(fname);}
     CLM(PDM3D &s,cv::Mat &r, std::vector<cv::Mat> &c,
 	std::vector<cv::Mat> &v,std::vector<std::vector<MPatch> > &p){
-      this->Init(s,r,c,v,p);
+      _profiler = NULL; this->Init(s,r,c,v,p);
     }
     CLM& operator=(CLM const&rhs);
+    void Share(CLM const&rhs); /**< share model data, own fitting state */
     inline int nViews(){return _patch.size();}
     int GetViewIdx();
+    void SetPrecision(int type); /**< CV_64F or CV_32F responses and shape */
+    inline int Precision(){return _pdm.Precision();}
     void Load(const char* fname, bool binary = false);
     void Save(const char* fname, bool binary = false);
     void Write(std::ofstream &s, bool binary = false);
     void Read(std::ifstream &s,bool readType = true);
-    void ReadBinary(std::ifstream &s, bool readType = true);
+    void ReadBinary(std::istream &s, bool readType = true);
     void Init(PDM3D &s,cv::Mat &r, std::vector<cv::Mat> &c,
 	      std::vector<cv::Mat> &v,std::vector<std::vector<MPatch> > &p);
     void Fit(cv::Mat& im, std::vector<int> &wSize,
@@ -76,23 +105,25 @@ namespace FACETRACKER
 		  void* data);
   private:
     cv::Mat cshape_,bshape_,oshape_,ms_,u_,g_,J_,H_; 
-    std::vector<cv::Mat> prob_,pmem_,wmem_;
-    void Optimize(int idx,int wSize,int nIter,
-		  double fTol,double clamp,bool rigid);
+    std::vector<cv::Mat> prob_,pmem_,wmem_,xloc_,yloc_;
+    std::vector<KDEKernel> kern_; std::vector<int> kidx_; cv::Mat kmem_;
+    int Kernel(int size,double sigma);
+    int Optimize(int idx,int wSize,int nIter, //returns iterations run
+		 double fTol,double clamp,bool rigid);
     void Optimize(int idx,cv::Mat &mu,cv::Mat &covi,int wSize,int nIter,
 		  double fTol,double clamp,double lambda);
     void OptimizeFwdAdd(std::vector<cv::Mat> &xloc,
 			std::vector<cv::Mat> &yloc,
 			int idx,int wSize,int nIter,
 			double fTol,double clamp,bool rigid);
-    void OptimizePrior(std::vector<cv::Mat> &xloc,
-		       std::vector<cv::Mat> &yloc,
-		       int idx,int wSize,int nIter,
-		       double fTol,double clamp,bool rigid,
-		       double lambda,cv::Mat &im,
-		       void (*pfunc)(cv::Mat &im,cv::Mat &s, cv::Mat &dxdp,
-				     cv::Mat &H,cv::Mat &g,void* data),
-		       void* data);
+    int OptimizePrior(std::vector<cv::Mat> &xloc,
+		      std::vector<cv::Mat> &yloc,
+		      int idx,int wSize,int nIter,
+		      double fTol,double clamp,bool rigid,
+		      double lambda,cv::Mat &im,
+		      void (*pfunc)(cv::Mat &im,cv::Mat &s, cv::Mat &dxdp,
+				    cv::Mat &H,cv::Mat &g,void* data),
+		      void* data);
    std::vector<DetectorNCC> _detectorsNCC;
     int _kWidth;
   };
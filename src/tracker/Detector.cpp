@@ -21,6 +21,8 @@
 
 #include "Detector.hpp"
 #include "IO.hpp"
+#include "CLM.hpp"
+#include "ThreadPool.hpp"
 
 using namespace FACETRACKER;
 using namespace std;
@@ -65,30 +67,10 @@ void Align2DShapes(cv::Mat &src,cv::Mat &dst,double &scale,double &theta)
 void CalcSimT(cv::Mat&src, cv::Mat&dst,
 	      cv::Mat &M)
 {
-  assert((src.type() == CV_REAL) && (dst.type() == CV_REAL) && 
-	 (src.rows == dst.rows) && (src.cols == dst.cols) && (src.cols == 1));
-  int i,n = src.rows/2;
-  cv::Mat H(4,4,CV_REAL,cv::Scalar(0));
-  cv::Mat g(4,1,CV_REAL,cv::Scalar(0));
-  cv::Mat p(4,1,CV_REAL);
-  cv::MatIterator_<double> ptr1x = src.begin<double>();
-  cv::MatIterator_<double> ptr1y = src.begin<double>()+n;
-  cv::MatIterator_<double> ptr2x = dst.begin<double>();
-  cv::MatIterator_<double> ptr2y = dst.begin<double>()+n;
-  for(i = 0; i < n; i++,++ptr1x,++ptr1y,++ptr2x,++ptr2y){
-    H.rl(0,0) += SQR(*ptr1x) + SQR(*ptr1y);
-    H.rl(0,2) += *ptr1x; H.rl(0,3) += *ptr1y;
-    g.rl(0,0) += (*ptr1x)*(*ptr2x) + (*ptr1y)*(*ptr2y);
-    g.rl(1,0) += (*ptr1x)*(*ptr2y) - (*ptr1y)*(*ptr2x);
-    g.rl(2,0) += *ptr2x; g.rl(3,0) += *ptr2y;
-  }
-  H.rl(1,1) = H.rl(0,0); H.rl(1,2) = H.rl(2,1) = -1.0*(H.rl(3,0) = H.rl(0,3));
-  H.rl(1,3) = H.rl(3,1) = H.rl(2,0) = H.rl(0,2); H.rl(2,2) = H.rl(3,3) = n;
-  cv::solve(H,g,p,cv::DECOMP_CHOLESKY);
-  M = (cv::Mat_<real>(2,3) << p.rl(0,0), -p.rl(1,0), p.rl(2,0), 
-       p.rl(1,0), p.rl(0,0), p.rl(3,0));
-  //  a = p.rl(0,0); b = p.rl(1,0); tx = p.rl(2,0); ty = p.rl(3,0); 
-  return;  
+  assert((M.type() == CV_REAL) && (M.rows == 2) && (M.cols == 3));
+  double a,b,tx,ty; FACETRACKER::CalcSimT(src,dst,a,b,tx,ty);
+  M.rl(0,0) = a; M.rl(0,1) = -b; M.rl(0,2) = tx; 
+  M.rl(1,0) = b; M.rl(1,1) =  a; M.rl(1,2) = ty; return;  
 }
 //===========================================================================
 //===========================================================================
@@ -147,6 +129,42 @@ Detector::getResponsesForRefShape(cv::Mat r, double *sc_)
   }
 }
 //===========================================================================
+void
+Detector::getResponsesForRefShape(cv::Mat r, std::vector<cv::Mat> &resp)
+{
+  if(r.empty()){resp = prob_; return;}
+
+  //align the mean removed shapes in place of removeMean and Align2DShapes
+  int i,n = r.rows/2; double mx = 0,my = 0,a = 0,b = 0,c = 0;
+  for(i = 0; i < n; i++){mx += r.rl(i,0); my += r.rl(i+n,0);}
+  mx /= n; my /= n;
+  for(i = 0; i < n; i++){
+    double x = r.rl(i,0) - mx, y = r.rl(i+n,0) - my;
+    double u = _refs_zm.rl(i,0), v = _refs_zm.rl(i+n,0);
+    a += x*x + y*y; b += x*u + y*v; c += x*v - y*u;
+  }
+  b /= a; c /= a; double scale = std::sqrt(b*b+c*c), theta = std::atan2(c,b);
+  if(fabs(theta) > .1){
+    std::cerr << "Reference shapes can only differ in scale" << std::endl;
+    exit(-1);
+  }
+  if(fabs(scale-1.)<1e-2){resp = prob_; return;}
+
+  cv::Size sz;
+  for(i = 0; i < int(prob_.size()); i++){
+    if(!prob_[i].empty()){
+      sz = cv::Size(prob_[i].cols / scale, prob_[i].rows / scale); break;
+    }
+  }
+  if(sz.width%2==0) sz.width++;
+  if(sz.height%2==0) sz.height++;
+  resp.resize(prob_.size());
+  for(i = 0; i < int(prob_.size()); i++){
+    if(prob_[i].empty()) resp[i].release();
+    else cv::resize(prob_[i], resp[i], sz);
+  }
+}
+//===========================================================================
 
 std::vector<cv::Mat>
 Detector::getResponsesForRefShape(cv::Size wSize, cv::Mat r)
@@ -256,7 +274,7 @@ DetectorNCC::DetectorNCC(std::string file, bool binary)
 // }
 
 void
-DetectorNCC::ReadBinary(std::ifstream &s, bool readType)
+DetectorNCC::ReadBinary(std::istream &s, bool readType)
 {
   if(readType){int type;
     s.read(reinterpret_cast<char*>(&type), sizeof(type));
@@ -274,7 +292,7 @@ DetectorNCC::ReadBinary(std::ifstream &s, bool readType)
   _refs_zm = _refs.clone();
   double tx, ty;
   removeMean(_refs_zm, tx, ty);
-
+  this->Pack();
 }
 
 void
@@ -323,44 +341,72 @@ DetectorNCC::Save(std::string fname, bool binary)
   s.close();
 }
 
+void
+DetectorNCC::Share(DetectorNCC const& rhs)
+{
+  _refs = rhs._refs;
+  _refs_zm = rhs._refs_zm;
+  _type = rhs._type;
+  _patch.resize(rhs._patch.size());
+  for(size_t i=0; i<rhs._patch.size(); i++)
+    _patch[i].Share(rhs._patch[i]);
+  _bank = rhs._bank;
+  bmem_.clear();
+  prob_.clear();
+  pmem_.clear();
+  win_ = FACETRACKER::WindowBatch();
+}
+
+//patch expert responses of each visible landmark
+struct ResponseBody : public ParallelBody{
+  PatchBank &bank; std::vector<PatchBank::Scratch> &bmem;
+  std::vector<cv::Mat> &prob,&pmem; 
+  WindowBatch &win; cv::Mat &visi; cv::Size wSize; int type;
+  ResponseBody(PatchBank &b,std::vector<PatchBank::Scratch> &bm,
+	       std::vector<cv::Mat> &pr,std::vector<cv::Mat> &pm,
+	       WindowBatch &w,cv::Mat &v,cv::Size ws,int t)
+    : bank(b),bmem(bm),prob(pr),pmem(pm),win(w),visi(v),wSize(ws),type(t){;}
+  void operator()(int begin,int end){
+    for(int i=begin; i<end; i++){
+      if(visi.it(i,0) ==0) continue;
+      cv::Mat wimg = win.Window(i);
+      if((wSize.height > pmem[i].rows) || (pmem[i].type() != type))
+	pmem[i].create(wSize.height, nextMultipleOf4(wSize.width), type);
+      
+      prob[i] = pmem[i](cv::Rect(cv::Point(0,0),wSize));
+      bank.Response(i,wimg,prob[i],bmem[i]);
+    }
+  }
+};
+
 bool
 DetectorNCC::response(cv::Mat & im, cv::Mat & sh,
 		      cv::Size wSize,
 		      cv::Mat& visi)
 {
 
-  cv::Mat simTransfMat;
-  CalcSimT(_refs, sh, simTransfMat);
+  real sim[6]; cv::Mat simT(2,3,CV_REAL,sim);
+  CalcSimT(_refs, sh, simT);
 
   int n = sh.rows/2;
   cv::Mat shape = sh.reshape(0,2);
 
   prob_.resize(n);
-  wmem_.resize(n);
   pmem_.resize(n);
+  bmem_.resize(n);
+  if(_bank.nPoints() != int(_patch.size()))this->Pack();
 
-#ifdef _OPENMP
-#pragma omp parallel for
-#endif
+  //all windows share the rotation and scale of simT
+  wsize_.resize(n);
   for(int i=0; i<n; i++){
-    if(visi.it(i,0) ==0) continue;
-    int w = wSize.width + _patch[i]._w - 1; 
-    int h = wSize.height + _patch[i]._h - 1;
-    simTransfMat.rl(0,2) = shape.rl(0,i);
-    simTransfMat.rl(1,2) = shape.rl(1,i);
- 
-    if((w>wmem_[i].cols) || (h>wmem_[i].rows))
-      wmem_[i].create(h,nextMultipleOf4(w),CV_32F);
-    
-    cv::Mat wimg = wmem_[i](cv::Rect(0,0,w,h));
-    CvMat wimg_o = wimg,sim_o = simTransfMat; IplImage im_o = im;
-    cvGetQuadrangleSubPix(&im_o,&wimg_o,&sim_o);
-    if(wSize.height > pmem_[i].rows)
-      pmem_[i].create(wSize.height, nextMultipleOf4(wSize.width), CV_REAL);
-    
-    prob_[i] = pmem_[i](cv::Rect(cv::Point(0,0),wSize));
-    _patch[i].Response(wimg,prob_[i]);
+    if(visi.it(i,0) ==0) wsize_[i] = cv::Size(0,0);
+    else wsize_[i] = cv::Size(wSize.width + _patch[i]._w - 1,
+			      wSize.height + _patch[i]._h - 1);
   }
+  win_.Extract(im,sim[0],sim[1],sim[3],sim[4],shape,wsize_);
+
+  ResponseBody body(_bank,bmem_,prob_,pmem_,win_,visi,wSize,_type);
+  ParallelFor(0,n,body);
 
   return true;
 }
@@ -27,10 +27,10 @@
 
 class Detector{
 public:
-  Detector(){};
+  Detector(){_type = CV_64F;};
   virtual ~Detector(){};
 
-  virtual void ReadBinary(std::ifstream& s, bool readType)=0;
+  virtual void ReadBinary(std::istream& s, bool readType)=0;
   virtual void Read(std::ifstream& s, bool readType)=0;
   virtual void Write(std::ofstream& s, bool binary = true)=0;
   virtual void Load(std::string fname, bool binary = true)=0;
@@ -47,6 +47,9 @@ public:
   //resize the responses, and return the used scale
   virtual std::vector<cv::Mat>
   getResponsesForRefShape( cv::Mat r, double *sc = NULL);
+  //as above, reusing the memory of resp
+  virtual void
+  getResponsesForRefShape(cv::Mat r, std::vector<cv::Mat> &resp);
   //resize the responses with the given scale
   virtual std::vector<cv::Mat>
   getResponsesForRefShape(double scale = 1.);
@@ -57,24 +60,30 @@ public:
   cv::Mat _refs_zm; // reference shape with mean removed
 
   std::vector<cv::Mat> prob_;
+  int _type; //CV_32F or CV_64F, type of the responses in prob_
 
 };
 
 
 class DetectorNCC : public Detector{
 
-  std::vector<cv::Mat> pmem_, wmem_;
+  std::vector<cv::Mat> pmem_;
+  FACETRACKER::WindowBatch win_; std::vector<cv::Size> wsize_;
+  std::vector<FACETRACKER::PatchBank::Scratch> bmem_;
 
 public:
   DetectorNCC(){};
   DetectorNCC(std::string file, bool binary);
   ~DetectorNCC(){};
   
-  void ReadBinary(std::ifstream& s, bool readType = true);
+  void ReadBinary(std::istream& s, bool readType = true);
   void Write(std::ofstream &s, bool binary = true);
   void Read(std::ifstream &s, bool readType = true);
   void Load(std::string fname, bool binary = true);
   void Save(std::string fname, bool binary = true);
+
+  //share the patch experts and reference shape of rhs, own scratch memory
+  void Share(DetectorNCC const& rhs);
   
   bool response(cv::Mat& img, cv::Mat &shape,
 		cv::Size wSize, 
@@ -82,7 +91,11 @@ public:
 
   // void setPatchExperts(std::vector<FACETRACKER::MPatch>& p);
 
+  //repack _patch into _bank, needed after _patch is changed
+  void Pack(){_bank.Pack(_patch);}
+
   std::vector<FACETRACKER::MPatch> _patch;
+  FACETRACKER::PatchBank _bank; //_patch as evaluated by response()
 
 };
 
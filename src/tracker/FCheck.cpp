@@ -78,7 +78,7 @@ void FCheck::Read(ifstream &s,bool readType)
   return;
 }
 //===========================================================================
-void FCheck::ReadBinary(ifstream &s,bool readType)
+void FCheck::ReadBinary(istream &s,bool readType)
 {
   if(readType){int type; 
     s.read(reinterpret_cast<char*>(&type), sizeof(type));
@@ -158,7 +158,7 @@ void MFCheck::Read(ifstream &s,bool readType)
   for(int i = 0; i < n; i++)_fcheck[i].Read(s); return;
 }
 //===========================================================================
-void MFCheck::ReadBinary(ifstream &s,bool readType)
+void MFCheck::ReadBinary(istream &s,bool readType)
 {
   if(readType){int type; 
     s.read(reinterpret_cast<char*>(&type), sizeof(type));
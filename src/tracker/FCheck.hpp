@@ -42,7 +42,7 @@ namespace FACETRACKER
     void Save(const char* fname, bool binary = false);
     void Write(std::ofstream &s, bool binary = false);
     void Read(std::ifstream &s,bool readType = true);
-    void ReadBinary(std::ifstream &s,bool readType = true);
+    void ReadBinary(std::istream &s,bool readType = true);
     bool Check(cv::Mat &im,cv::Mat &s);
     
   private:
@@ -67,7 +67,7 @@ namespace FACETRACKER
     void Save(const char* fname, bool binary = false);
     void Write(std::ofstream &s, bool binary = false);
     void Read(std::ifstream &s,bool readType = true);
-    void ReadBinary(std::ifstream &s,bool readType = true);
+    void ReadBinary(std::istream &s,bool readType = true);
     bool Check(int idx,cv::Mat &im,cv::Mat &s);
   };
   //===========================================================================
@@ -25,7 +25,6 @@ using namespace std;
 FDet::~FDet()
 {  
   if(storage_ != NULL)cvReleaseMemStorage(&storage_);
-  if(_cascade != NULL)cvReleaseHaarClassifierCascade(&_cascade);
 }
 //===========================================================================
 FDet& FDet::operator= (FDet const& rhs)
@@ -46,21 +45,87 @@ void FDet::Init(const char* fname,
 		const int    min_neighbours,
 		const int    min_size)
 {
-  if(!(_cascade = (CvHaarClassifierCascade*)cvLoad(fname,0,0,0))){
+  _cascade = (CvHaarClassifierCascade*)cvLoad(fname,0,0,0);
+  if(_cascade.empty()){
     printf("ERROR(%s,%d) : Failed loading classifier cascade!\n",
 	   __FILE__,__LINE__); abort();
   }
-  storage_        = cvCreateMemStorage(0);
+  if(storage_ == NULL)storage_ = cvCreateMemStorage(0);
   _img_scale      = img_scale;
   _scale_factor   = scale_factor;
   _min_neighbours = min_neighbours;
   _min_size       = min_size; return;
 }
 //===========================================================================
+//largest of the faces
+static cv::Rect Largest(vector<FaceCandidate> &faces)
+{
+  int i,maxv; cv::Rect R(0,0,0,0);
+  for(i = 0,maxv = 0; i < int(faces.size()); i++){
+    if(i == 0 || maxv < faces[i].rect.area()){
+      maxv = faces[i].rect.area(); R = faces[i].rect;
+    }
+  }return R;
+}
+//===========================================================================
+static vector<cv::Rect> Rects(vector<FaceCandidate> &faces)
+{
+  vector<cv::Rect> R(faces.size());
+  for(int i = 0; i < int(faces.size()); i++)R[i] = faces[i].rect;
+  return R;
+}
+//===========================================================================
+//deep copy with the layout of FDet::Read, so that it is freed the same way
+static CvHaarClassifierCascade* 
+CloneCascade(const CvHaarClassifierCascade* src)
+{
+  int i,j,k,n = src->count;
+  int m = sizeof(CvHaarClassifierCascade)+n*sizeof(CvHaarStageClassifier);
+  CvHaarClassifierCascade* dst = (CvHaarClassifierCascade*)cvAlloc(m);
+  memset(dst,0,m);
+  dst->stage_classifier = (CvHaarStageClassifier*)(dst + 1);
+  dst->flags = CV_HAAR_MAGIC_VAL; dst->count = n;
+  dst->orig_window_size = src->orig_window_size;
+  for(i = 0; i < n; i++){
+    const CvHaarStageClassifier &a = src->stage_classifier[i];
+    CvHaarStageClassifier &b = dst->stage_classifier[i];
+    b.parent = a.parent; b.next = a.next; b.child = a.child;
+    b.threshold = a.threshold; b.count = a.count;
+    b.classifier = (CvHaarClassifier*)cvAlloc(a.count*sizeof(CvHaarClassifier));
+    for(j = 0; j < a.count; j++){
+      const CvHaarClassifier &c = a.classifier[j];
+      CvHaarClassifier &d = b.classifier[j]; k = c.count; d.count = k;
+      d.haar_feature = (CvHaarFeature*) 
+	cvAlloc(k*(sizeof(CvHaarFeature) + sizeof(float) + sizeof(int) + 
+		   sizeof(int)) + (k+1)*sizeof(float));
+      d.threshold = (float*)(d.haar_feature + k);
+      d.left = (int*)(d.threshold + k);
+      d.right = (int*)(d.left + k);
+      d.alpha = (float*)(d.right + k);
+      memcpy(d.haar_feature,c.haar_feature,k*sizeof(CvHaarFeature));
+      memcpy(d.threshold,c.threshold,k*sizeof(float));
+      memcpy(d.left,c.left,k*sizeof(int));
+      memcpy(d.right,c.right,k*sizeof(int));
+      memcpy(d.alpha,c.alpha,(k+1)*sizeof(float));
+    }
+  }return dst;
+}
+//===========================================================================
 cv::Rect FDet::Detect(cv::Mat im)
+{
+  vector<FaceCandidate> faces; this->Detect(im,faces); return Largest(faces);
+}
+//===========================================================================
+vector<cv::Rect> FDet::DetectAll(cv::Mat im)
+{
+  vector<FaceCandidate> faces; this->Detect(im,faces); return Rects(faces);
+}
+//===========================================================================
+void FDet::Detect(cv::Mat &im,vector<FaceCandidate> &faces)
 {
   assert(im.type() == CV_8U);
-  cv::Mat gray; int i,maxv; cv::Rect R;
+  faces.clear(); if(_cascade.empty())return;
+  cv::Mat gray; int i; FaceCandidate F;
   int w = cvRound(im.cols/_img_scale);
   int h = cvRound(im.rows/_img_scale);
   if((small_img_.rows!=h) || (small_img_.cols!=w))small_img_.create(h,w,CV_8U);
@@ -72,15 +137,93 @@ cv::Rect FDet::Detect(cv::Mat im)
   CvSeq* obj = cvHaarDetectObjects(&simg,_cascade,storage_,
 				   _scale_factor,_min_neighbours,0,
 				   cv::Size(_min_size,_min_size));
-  if(obj->total == 0)return cv::Rect(0,0,0,0);
-  for(i = 0,maxv = 0; i < obj->total; i++){
-    CvRect* r = (CvRect*)cvGetSeqElem(obj,i);
-    if(i == 0 || maxv < r->width*r->height){
-      maxv = r->width*r->height; R.x = r->x*_img_scale; R.y = r->y*_img_scale;
-      R.width  = r->width*_img_scale; R.height = r->height*_img_scale;
+  for(i = 0; i < obj->total; i++){
+    CvAvgComp* r = (CvAvgComp*)cvGetSeqElem(obj,i);
+    F.rect.x = r->rect.x*_img_scale; F.rect.y = r->rect.y*_img_scale;
+    F.rect.width  = r->rect.width*_img_scale; 
+    F.rect.height = r->rect.height*_img_scale;
+    F.score = r->neighbors; faces.push_back(F);
+  }
+  cvRelease((void**)(&obj)); return;
+}
+//===========================================================================
+PyramidFDet::PyramidFDet(FDet const& fdet)
+{
+  fdet_ = fdet;
+}
+//===========================================================================
+void PyramidFDet::operator()(int begin,int end)
+{
+  //a cascade and storage no other thread is using
+  CvHaarClassifierCascade* cascade; CvMemStorage* storage; int t;
+  lock_.lock();
+  if(free_.empty()){
+    t = cascade_.size(); cascade_.push_back(CloneCascade(fdet_._cascade));
+    storage_.push_back(cvCreateMemStorage(0));
+  }else{t = free_.back(); free_.pop_back();}
+  cascade = cascade_[t]; storage = storage_[t];
+  lock_.unlock();
+
+  //only the cascade's own window size is tried at each level
+  CvSize win = fdet_._cascade->orig_window_size;
+  for(int i = begin; i < end; i++){
+    double f = scale_[i];
+    cv::Size sz(std::max(win.width,cvRound(small_.cols/f)),
+		std::max(win.height,cvRound(small_.rows/f)));
+    cv::resize(small_,level_[i],sz,0,0,CV_INTER_LINEAR);
+    cvClearMemStorage(storage); IplImage img = level_[i];
+    CvSeq* obj = cvHaarDetectObjects(&img,cascade,storage,
+				     fdet_._scale_factor,0,0,win,win);
+    hits_[i].clear();
+    for(int j = 0; j < obj->total; j++){
+      CvRect* r = (CvRect*)cvGetSeqElem(obj,j);
+      hits_[i].push_back(cv::Rect(cvRound(r->x*f),cvRound(r->y*f),
+				  cvRound(r->width*f),cvRound(r->height*f)));
     }
   }
-  cvRelease((void**)(&obj)); return R;
+  lock_.lock(); free_.push_back(t); lock_.unlock(); return;
+}
+//===========================================================================
+PyramidFDet::~PyramidFDet()
+{
+  for(int i = 0; i < int(storage_.size()); i++)cvReleaseMemStorage(&storage_[i]);
+}
+//===========================================================================
+void PyramidFDet::Detect(cv::Mat &im,vector<FaceCandidate> &faces)
+{
+  assert(im.type() == CV_8U);
+  faces.clear(); if(fdet_._cascade.empty())return;
+
+  //the image FDet runs its cascade on
+  int w = cvRound(im.cols/fdet_._img_scale);
+  int h = cvRound(im.rows/fdet_._img_scale);
+  if((small_.rows != h) || (small_.cols != w))small_.create(h,w,CV_8U);
+  cv::resize(im,small_,cv::Size(w,h),0,0,CV_INTER_LINEAR);
+  cv::equalizeHist(small_,small_);
+
+  //scales at which the cascade window is at least min_size and fits
+  CvSize win = fdet_._cascade->orig_window_size; scale_.clear();
+  for(double f = 1; (f*win.width <= w) && (f*win.height <= h); 
+      f *= fdet_._scale_factor){
+    if((f*win.width >= fdet_._min_size) && (f*win.height >= fdet_._min_size))
+      scale_.push_back(f);
+  }
+  int n = scale_.size(); level_.resize(n); hits_.resize(n);
+  ParallelFor(0,n,*this);
+
+  //group the hits of all levels together, as cvHaarDetectObjects does
+  rects_.clear();
+  for(int i = 0; i < n; i++)
+    rects_.insert(rects_.end(),hits_[i].begin(),hits_[i].end());
+  //without grouping (_min_neighbours 0) every hit stands alone
+  weights_.clear();
+  cv::groupRectangles(rects_,weights_,fdet_._min_neighbours,0.2);
+  double s = fdet_._img_scale; faces.resize(rects_.size());
+  for(int i = 0; i < int(rects_.size()); i++){
+    cv::Rect &r = rects_[i];
+    faces[i].rect = cv::Rect(r.x*s,r.y*s,r.width*s,r.height*s);
+    faces[i].score = (i < int(weights_.size())) ? weights_[i] : 1;
+  }return;
 }
 //===========================================================================
 void FDet::Load(const char* fname, bool binary)
@@ -182,10 +325,11 @@ void FDet::Read(ifstream &s,bool readType)
   if(readType){int type; s >> type; assert(type == IO::FDET);}
   s >> _min_neighbours >> _min_size >> _img_scale >> _scale_factor >> n;
   m = sizeof(CvHaarClassifierCascade)+n*sizeof(CvHaarStageClassifier);
-  storage_ = cvCreateMemStorage(0);
-  _cascade = (CvHaarClassifierCascade*)cvAlloc(m);
-  memset(_cascade,0,m);
-  _cascade->stage_classifier = (CvHaarStageClassifier*)(_cascade + 1);
+  if(storage_ == NULL)storage_ = cvCreateMemStorage(0);
+  CvHaarClassifierCascade* cascade = (CvHaarClassifierCascade*)cvAlloc(m);
+  memset(cascade,0,m);
+  cascade->stage_classifier = (CvHaarStageClassifier*)(cascade + 1);
+  _cascade = cascade;
   _cascade->flags = CV_HAAR_MAGIC_VAL;
   _cascade->count = n;
   s >> _cascade->orig_window_size.width >> _cascade->orig_window_size.height;
@@ -230,7 +374,7 @@ void FDet::Read(ifstream &s,bool readType)
   }return;
 }
 //===========================================================================
-void  FDet::ReadBinary(ifstream &s,bool readType)
+void  FDet::ReadBinary(istream &s,bool readType)
 {  
 
   int i,j,k,l, n,m;
@@ -246,10 +390,11 @@ void  FDet::ReadBinary(ifstream &s,bool readType)
   s.read(reinterpret_cast<char*>(&_scale_factor), sizeof(_scale_factor));
   s.read(reinterpret_cast<char*>(&n), sizeof(n));
   m = sizeof(CvHaarClassifierCascade)+n*sizeof(CvHaarStageClassifier);
-  storage_ = cvCreateMemStorage(0);
-  _cascade = (CvHaarClassifierCascade*)cvAlloc(m);
-  memset(_cascade,0,m);
-  _cascade->stage_classifier = (CvHaarStageClassifier*)(_cascade + 1);
+  if(storage_ == NULL)storage_ = cvCreateMemStorage(0);
+  CvHaarClassifierCascade* cascade = (CvHaarClassifierCascade*)cvAlloc(m);
+  memset(cascade,0,m);
+  cascade->stage_classifier = (CvHaarStageClassifier*)(cascade + 1);
+  _cascade = cascade;
   _cascade->flags = CV_HAAR_MAGIC_VAL;
   _cascade->count = n;
 
@@ -294,6 +439,31 @@ void  FDet::ReadBinary(ifstream &s,bool readType)
   }
   
   
+}
+//===========================================================================
+void SInit::Detect(cv::Mat &im,vector<FaceCandidate> &faces)
+{
+  if(_detector.empty())_fdet.Detect(im,faces);
+  else _detector->Detect(im,faces);
+  return;
+}
+//===========================================================================
+cv::Rect SInit::Detect(cv::Mat &im)
+{
+  vector<FaceCandidate> faces; this->Detect(im,faces); return Largest(faces);
+}
+//===========================================================================
+vector<cv::Rect> SInit::DetectAll(cv::Mat &im)
+{
+  vector<FaceCandidate> faces; this->Detect(im,faces); return Rects(faces);
+}
+//===========================================================================
+void SInit::Share(SInit const&rhs)
+{
+  _rshape = rhs._rshape; _simil = rhs._simil; 
+  temp_.release(); ncc_.release(); small_.release(); tmem_.release();
+  imem_.release(); fmem_.release(); nmem_.release(); pyr_ = FramePyramid();
+  rect_ = cv::Rect(); vel_ = cv::Point2d(0,0); return;
 }
 //===========================================================================
 void SInit::Load(const char* fname, bool binary)
@@ -345,7 +515,7 @@ void SInit::Read(ifstream &s,bool readType)
   return;
 }
 //===========================================================================
-void SInit::ReadBinary(ifstream &s,bool readType)
+void SInit::ReadBinary(istream &s,bool readType)
 {
 
   if(readType){int type; 
@@ -361,7 +531,7 @@ void SInit::ReadBinary(ifstream &s,bool readType)
 int SInit::InitShape(cv::Mat &im,cv::Mat &shape, cv::Rect r)
 {
   int i,n = _rshape.rows/2; double a,b,tx,ty;
-  if(r.width<=0) r = _fdet.Detect(im); if((r.width==0)||(r.height==0))return -1;
+  if(r.width<=0) r = this->Detect(im); if((r.width==0)||(r.height==0))return -1;
   if(!((shape.rows == _rshape.rows) && (shape.cols == _rshape.cols) &&
        (shape.type() == CV_64F))){
     shape.create(_rshape.rows,_rshape.cols,CV_64F);
@@ -379,31 +549,74 @@ int SInit::InitShape(cv::Mat &im,cv::Mat &shape, cv::Rect r)
   }return 0;
 }
 //===========================================================================
-cv::Rect SInit::ReDetect(cv::Mat &im)
+//continuous header on the memory of buf, which only grows
+static cv::Mat Reserve(cv::Mat &buf,int rows,int cols,int type)
+{
+  size_t n = size_t(rows)*cols*CV_ELEM_SIZE(type);
+  if(buf.total() < n)buf.create(1,n,CV_8U);
+  return cv::Mat(rows,cols,type,buf.data);
+}
+//===========================================================================
+double SInit::Search(FramePyramid &pyr,cv::Rect S,cv::Rect &R,bool full)
+{
+  double v; cv::Point p; cv::Mat ncc;
+  small_ = pyr.Scaled(TSCALE,S)(S);
+  if(full){ //FFT based, faster for whole frames
+    cv::matchTemplate(small_,temp_,ncc_,CV_TM_CCOEFF_NORMED); ncc = ncc_;
+  }else{
+    cv::Mat I = Reserve(imem_,S.height,S.width,CV_32F); 
+    cv::Mat T = Reserve(fmem_,temp_.rows,temp_.cols,CV_32F);
+    small_.convertTo(I,CV_32F); temp_.convertTo(T,CV_32F);
+    ncc = Reserve(nmem_,S.height-T.rows+1,S.width-T.cols+1,CV_32F);
+    corr_.Correlate(I,T,ncc);
+  }
+  cv::minMaxLoc(ncc,NULL,&v,NULL,&p);
+  R = cv::Rect(S.x+p.x,S.y+p.y,temp_.cols,temp_.rows); return v;
+}
+//===========================================================================
+cv::Rect SInit::ReDetect(cv::Mat &im,double radius,double thresh,bool full)
+{
+  pyr_.Reset(im); return this->ReDetect(pyr_,radius,thresh,full);
+}
+//===========================================================================
+cv::Rect SInit::ReDetect(FramePyramid &pyr,double radius,double thresh,
+			 bool full)
 {
   if(temp_.rows == 0)return cv::Rect();
-  int x,y; float v,vb=-2;
-  int ww = im.cols,hh = im.rows;
-  int w = TSCALE*ww-temp_.cols+1,h = TSCALE*hh-temp_.rows+1;
-  if((small_.rows != TSCALE*hh) || (small_.cols != TSCALE*ww))
-    small_.create(TSCALE*hh,TSCALE*ww,CV_8U);
-  cv::resize(im,small_,cv::Size(TSCALE*ww,TSCALE*hh),0,0,CV_INTER_LINEAR);
-  if((ncc_.rows != h) || (ncc_.cols != w))ncc_.create(h,w,CV_32F);
-  IplImage im_o = small_,temp_o = temp_,ncc_o = ncc_;
-  cvMatchTemplate(&im_o,&temp_o,&ncc_o,CV_TM_CCOEFF_NORMED);
-  cv::MatIterator_<float> p = ncc_.begin<float>(); cv::Rect R;  
-  R.width = temp_.cols; R.height = temp_.rows;
-  for(y = 0; y < h; y++){
-    for(x = 0; x < w; x++){
-      v = *p++; if(v > vb){vb = v; R.x = x; R.y = y;}
-    }
+  cv::Mat &im = pyr.Image();
+  cv::Rect R,F(0,0,TSCALE*im.cols,TSCALE*im.rows); bool found = false;
+  if(radius > 0){
+    //search around the motion predicted template location
+    int rx = radius*temp_.cols,ry = radius*temp_.rows;
+    cv::Rect S(cvRound(rect_.x + vel_.x) - rx,cvRound(rect_.y + vel_.y) - ry,
+	       temp_.cols + 2*rx,temp_.rows + 2*ry);
+    S &= pyr.ScaledROI(TSCALE); //only the prepared part of it is current
+    if((S.width >= temp_.cols) && (S.height >= temp_.rows))
+      found = this->Search(pyr,S,R,false) >= thresh;
+  }
+  if(!found){
+    if(!full)return cv::Rect(0,0,0,0);
+    assert((F & pyr.ScaledROI(TSCALE)) == F);
+    this->Search(pyr,F,R,true);
   }
+  vel_.x = R.x - rect_.x; vel_.y = R.y - rect_.y;
   R.x *= 1.0/TSCALE; R.y *= 1.0/TSCALE; 
   R.width *= 1.0/TSCALE; R.height *= 1.0/TSCALE; return R;
 }
 //===========================================================================
+cv::Point2d SInit::Motion()
+{
+  return cv::Point2d(vel_.x/TSCALE,vel_.y/TSCALE);
+}
+//===========================================================================
 cv::Rect SInit::Update(cv::Mat &im,cv::Mat &s,bool rsize)
 {
+  pyr_.Reset(im); return this->Update(pyr_,s,rsize);
+}
+//===========================================================================
+cv::Rect SInit::Update(FramePyramid &pyr,cv::Mat &s,bool rsize)
+{
+  cv::Mat &im = pyr.Image();
   int i,n = s.rows/2; double vx,vy;
   cv::MatIterator_<double> x = s.begin<double>(),y = s.begin<double>()+n;
   double xmax=*x,ymax=*y,xmin=*x,ymin=*y;
@@ -420,14 +633,11 @@ cv::Rect SInit::Update(cv::Mat &im,cv::Mat &s,bool rsize)
     xmin *= TSCALE; ymin *= TSCALE; xmax *= TSCALE; ymax *= TSCALE;
     cv::Rect R = cv::Rect(std::floor(xmin),std::floor(ymin),
 			  std::ceil(xmax-xmin),std::ceil(ymax-ymin));
-    int ww = im.cols,hh = im.rows;
-    if(rsize){
-      if((small_.rows != TSCALE*hh) || (small_.cols != TSCALE*ww))
-	small_.create(TSCALE*hh,TSCALE*ww,CV_8U);
-      cv::resize(im,small_,cv::Size(TSCALE*ww,TSCALE*hh),0,0,CV_INTER_LINEAR);
-    }
-    cv::resize(im,small_,cv::Size(TSCALE*ww,TSCALE*hh),0,0,CV_INTER_LINEAR);
-    temp_ = small_(R).clone(); 
+    R &= cv::Rect(0,0,TSCALE*im.cols,TSCALE*im.rows);
+    if((R.width <= 0) || (R.height <= 0))return cv::Rect(0,0,0,0);
+    if(rsize)vel_ = cv::Point2d(0,0);
+    temp_ = Reserve(tmem_,R.height,R.width,CV_8U); 
+    pyr.Scaled(TSCALE,R)(R).copyTo(temp_); rect_ = R;
     R.x *= 1.0/TSCALE; R.y *= 1.0/TSCALE; 
     R.width *= 1.0/TSCALE; R.height *= 1.0/TSCALE; return R;
   }
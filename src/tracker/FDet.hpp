@@ -20,27 +20,51 @@
 #ifndef _TRACKER_FDet_h_
 #define _TRACKER_FDet_h_
 #include <tracker/IO.hpp>
+#include <tracker/PatchKernels.hpp>
+#include <tracker/FramePyramid.hpp>
+#include <tracker/ThreadPool.hpp>
 namespace FACETRACKER
 {
+  //===========================================================================
+  /** A detected face and the detector's confidence in it */
+  struct FaceCandidate{
+    cv::Rect rect; /**< Face box in image coordinates  */
+    double score;  /**< Confidence, larger is better   */
+  };
+  //===========================================================================
+  /** 
+      Interface of the face detectors used to initialise tracking. A
+      detector returns every face it finds, each with a score.
+  */
+  class FaceDetector{
+  public:
+    virtual ~FaceDetector(){;}
+    virtual void 
+    Detect(cv::Mat &im,                            //grayscale image
+	   std::vector<FaceCandidate> &faces) = 0; //all faces on return
+  };
   //===========================================================================
   /** 
-      A wrapper for OpenCV's face detector
+      A wrapper for OpenCV's face detector. The score of a face is the
+      number of cascade hits merged into it.
   */
-  class FDet{
+  class FDet : public FaceDetector{
   public:    
     int                      _min_neighbours; /**< see OpenCV documentation */
     int                      _min_size;       /**< ...                      */
     double                   _img_scale;      /**< ...                      */
     double                   _scale_factor;   /**< ...                      */
-    CvHaarClassifierCascade* _cascade;        /**< ...                      */
+    cv::Ptr<CvHaarClassifierCascade> _cascade; /**< shared between copies  */
 
-    FDet(){storage_=NULL;_cascade=NULL;}
-    FDet(const char* fname){this->Load(fname);}
+    FDet(){storage_=NULL;}
+    FDet(FDet const&rhs){storage_=NULL; *this = rhs;}
+    FDet(const char* fname){storage_=NULL; this->Load(fname);}
     FDet(const char*  cascFile,
 	 const double img_scale, //1.3
 	 const double scale_factor = 1.1,
 	 const int    min_neighbours = 2,
 	 const int    min_size = 100){
+      storage_=NULL;
       this->Init(cascFile,img_scale,scale_factor,min_neighbours,min_size);
     }
     ~FDet();
@@ -50,37 +74,81 @@ namespace FACETRACKER
 	      const double scale_factor = 1.1,
 	      const int    min_neighbours = 2,
 	      const int    min_size = 30);
-    cv::Rect Detect(cv::Mat im);
+    cv::Rect Detect(cv::Mat im);               /**< largest face       */
+    std::vector<cv::Rect> DetectAll(cv::Mat im); /**< all detected faces */
+    void Detect(cv::Mat &im,std::vector<FaceCandidate> &faces);
     void Load(const char* fname, bool binary = false);
     void Save(const char* fname, bool binary = false);
     void Write(std::ofstream &s, bool binary = false
 	       );
     void Read(std::ifstream &s,bool readType = true);
-    void ReadBinary(std::ifstream &s,bool readType = true);
+    void ReadBinary(std::istream &s,bool readType = true);
     
   private:
     cv::Mat small_img_; CvMemStorage* storage_;
   };
   //===========================================================================
+  /**
+     The Haar cascade of an FDet run over the scales of its image
+     pyramid with ParallelFor, each thread with its own copy of the 
+     cascade.
+     The hits of all scales are grouped as FDet does, so it finds the
+     same faces.
+  */
+  class PyramidFDet : public FaceDetector, private ParallelBody{
+  public:
+    PyramidFDet(FDet const& fdet); //detector settings and cascade to use
+    ~PyramidFDet();
+    void Detect(cv::Mat &im,std::vector<FaceCandidate> &faces);
+  private:
+    FDet fdet_; cv::Mat small_; std::vector<double> scale_;
+    std::vector<cv::Ptr<CvHaarClassifierCascade> > cascade_; //per thread
+    std::vector<CvMemStorage*> storage_;                      //per thread
+    std::vector<int> free_; cv::Mutex lock_; //copies not in use
+    std::vector<cv::Mat> level_;                              //per scale
+    std::vector<std::vector<cv::Rect> > hits_;                //per scale
+    std::vector<cv::Rect> rects_; std::vector<int> weights_;
+    void operator()(int begin,int end); //levels [begin,end)
+    PyramidFDet(PyramidFDet const&);
+    PyramidFDet& operator=(PyramidFDet const&);
+  };
+  //===========================================================================
   /** Shape initializer */
   class SInit{
   public:
     FDet       _fdet;
+    cv::Ptr<FaceDetector> _detector; /**< Used instead of _fdet if set */
     cv::Mat    _rshape;
     cv::Scalar _simil;
     SInit(){;}
     SInit(const char* fname){this->Load(fname);}
+    void Share(SInit const&rhs); /**< share init model but not detector */
     void Load(const char* fname, bool binary = false);
     void Save(const char* fname, bool binary = false);
     void Write(std::ofstream &s, bool binary = false);
     void Read(std::ifstream &s,bool readType = true);
-    void ReadBinary(std::ifstream &s,bool readType = true);
+    void ReadBinary(std::istream &s,bool readType = true);
     int InitShape(cv::Mat &im,cv::Mat &shape, cv::Rect r = cv::Rect(0,0,0,0));
-    cv::Rect Detect(cv::Mat &im){return _fdet.Detect(im);}
-    cv::Rect ReDetect(cv::Mat &im);
+    cv::Rect Detect(cv::Mat &im);               //largest face
+    std::vector<cv::Rect> DetectAll(cv::Mat &im); //all faces
+    void Detect(cv::Mat &im,std::vector<FaceCandidate> &faces); //scored
+    cv::Rect ReDetect(cv::Mat &im,          //grayscale image
+		      double radius = 0,    //search radius (template sizes)
+		      double thresh = 0.5,  //full frame search below this
+		      bool full = true);    //else return an empty box
+    cv::Rect ReDetect(FramePyramid &pyr,double radius = 0,
+		      double thresh = 0.5,bool full = true);
     cv::Rect Update(cv::Mat &im,cv::Mat &s,bool rsize);
+    cv::Rect Update(FramePyramid &pyr,cv::Mat &s,bool rsize);
+    cv::Point2d Motion(); //template motion over the last frame (pixels)
   protected:
     cv::Mat temp_,ncc_,small_;
+    cv::Mat tmem_,imem_,fmem_,nmem_; //grown to the largest search
+    NCC corr_;
+    cv::Rect rect_; cv::Point2d vel_; //template location/motion (scaled)
+    FramePyramid pyr_; //for the cv::Mat versions
+
+    double Search(FramePyramid &pyr,cv::Rect S,cv::Rect &R,bool full);
   };
   //===========================================================================
 }
@@ -33,6 +33,28 @@ FaceTrackerParams::~FaceTrackerParams()
 FaceTracker::~FaceTracker()
 {
 
+}
+//===========================================================================
+void FrameView::BGR(cv::Mat &im) const
+{
+  cv::Mat y = this->Luma();
+  if(_format == GRAY){cv::cvtColor(y,im,CV_GRAY2BGR); return;}
+  if((_u == NULL) || ((_format == I420) && (_v == NULL))){
+    printf("ERROR(%s,%d) : frame has no chroma planes\n",__FILE__,__LINE__);
+    abort();
+  }
+  //OpenCV wants the planes one after the other without row padding
+  int w = _width,h = _height; cv::Mat yuv(h + h/2,w,CV_8U);
+  y.copyTo(yuv(cv::Rect(0,0,w,h)));
+  uchar* dst = yuv.ptr<uchar>(h);
+  if(_format == I420){
+    for(int i = 0; i < h/2; i++,dst += w/2)memcpy(dst,_u + i*_uvstride,w/2);
+    for(int i = 0; i < h/2; i++,dst += w/2)memcpy(dst,_v + i*_uvstride,w/2);
+    cv::cvtColor(yuv,im,CV_YUV2BGR_I420);
+  }else{
+    for(int i = 0; i < h/2; i++,dst += w)memcpy(dst,_u + i*_uvstride,w);
+    cv::cvtColor(yuv,im,(_format == NV12) ? CV_YUV2BGR_NV12:CV_YUV2BGR_NV21);
+  }return;
 }
 //===========================================================================
 FaceTracker* FACETRACKER::LoadFaceTracker(const char* fname)
@@ -49,6 +71,10 @@ FaceTracker* FACETRACKER::LoadFaceTracker(const char* fname)
     if(type == IOBinary::MYFACETRACKER){
       model = new myFaceTracker(fname, true);
     }
+    else if(type == IOBinary::MAPPED){
+      myFaceTracker* tracker = new myFaceTracker();
+      tracker->LoadMapped(fname); model = tracker;
+    }
     else
       printf("ERROR(%s,%d) : unknown facetracker type %d\n", 
 	     __FILE__,__LINE__,type);
@@ -20,6 +20,7 @@
 #ifndef _TRACKER_FaceTracker_h_
 #define _TRACKER_FaceTracker_h_
 #include <tracker/IO.hpp>
+#include <tracker/Profiler.hpp>
 namespace FACETRACKER
 {
   //============================================================================
@@ -78,6 +79,38 @@ namespace FACETRACKER
   // 
   cv::Mat_<double> pose_axes(const Pose &pose);
 
+  //============================================================================
+  /**
+     A frame held in someone else's memory, such as the YUV buffers
+     filled by hardware decoders and V4L2. The tracker only reads the
+     luma plane and does so in place. The chroma planes are only used
+     when a colour image is asked for, e.g. to display or render onto.
+  */
+  class FrameView{
+  public:
+    enum{GRAY = 0,NV12,NV21,I420};
+    const uchar* _y;    /**< Luma plane                                */
+    const uchar* _u;    /**< Interleaved chroma (NV12/NV21) or U plane */
+    const uchar* _v;    /**< V plane (I420)                            */
+    int _width,_height; /**< Size of the luma plane                    */
+    int _ystride;       /**< Bytes between luma rows                   */
+    int _uvstride;      /**< Bytes between chroma rows                 */
+    int _format;        /**< GRAY, NV12, NV21 or I420                  */
+
+    FrameView(const uchar* y,int width,int height,int ystride,
+	      int format = GRAY,const uchar* u = NULL,const uchar* v = NULL,
+	      int uvstride = 0) :
+      _y(y),_u(u),_v(v),_width(width),_height(height),_ystride(ystride),
+      _uvstride(uvstride),_format(format){;}
+
+    inline cv::Mat                //header onto the luma plane, no copy
+    Luma() const{
+      return cv::Mat(_height,_width,CV_8U,const_cast<uchar*>(_y),_ystride);
+    }
+    void 
+    BGR(cv::Mat &im) const;       //colour image on return
+  };
+
   //============================================================================
   /**
      Base class for a face tracker
@@ -86,8 +119,9 @@ namespace FACETRACKER
   public:
     virtual ~FaceTracker();
 
-    cv::Mat _shape;  /**< Current tracked shape */
-    fpsTimer _timer; /**< Frames/second timer   */
+    cv::Mat _shape;      /**< Current tracked shape */
+    fpsTimer _timer;     /**< Frames/second timer   */
+    Profiler _profiler;  /**< Per-stage timings     */
 
     inline double               //frames-per-second
     fps(){return _timer._fps;}
@@ -96,10 +130,21 @@ namespace FACETRACKER
     Track(cv::Mat &im,          //grayscale image to track
 	  FaceTrackerParams* params=NULL){   //additinal parameters
       _timer.start_frame(); 
+#ifdef WITH_PROFILER
+      _profiler.BeginFrame(); int r;
+      {PROFILE_STAGE(&_profiler,FRAME); r = this->NewFrame(im,params);}
+      _profiler.EndFrame();
+#else
       int r = this->NewFrame(im,params);
+#endif
       _timer.stop_frame();
       return r;
     }
+    inline int                  //-1 on failure, health (0-10) otherwise
+    Track(const FrameView &f,   //frame to track, read in place
+	  FaceTrackerParams* params=NULL){   //additinal parameters
+      cv::Mat im = f.Luma(); return this->Track(im,params);
+    }
     void 
     Load(const char* fname, bool binary){ //file containing predictor model
       std::ifstream s;
@@ -117,6 +162,12 @@ namespace FACETRACKER
       assert(s.is_open()); this->Write(s, binary); s.close(); 
       return;
     }
+    void 
+    SaveMapped(const char* fname){ //file to save memory mappable model to
+      std::ofstream s(fname, std::ios::binary); assert(s.is_open()); 
+      IOBinary::WriteMappedHeader(s); this->Write(s, true); s.close(); 
+      return;
+    }
     virtual void Reset()=0; //reset tracker
     enum {
       TRACKER_FAILED = -1,        // Failed to track the face.
@@ -137,17 +188,17 @@ namespace FACETRACKER
     Read(std::ifstream &s,        //file stream to read from
 	 bool readType = true)=0; //read type?
     virtual void
-    ReadBinary(std::ifstream &s,        //file stream to read from
+    ReadBinary(std::istream &s,        //file stream to read from
 	 bool readType = true)=0;
     virtual void 
     Write(std::ofstream &s, //file stream to write to
 	  bool binary = false)=0;
 
     //functions to get the clm parameters
-    //returns _clm._plocal, the parameters of the current shape in the shape basis
+    //returns the parameters of the current shape in the shape basis
     virtual cv::Mat
     getShapeParameters()=0;
-    //returns _clm._pglobl, the (weak perspective) pose in 3D
+    //returns the (weak perspective) pose in 3D
     virtual cv::Mat
     getPoseParameters()=0; 
   };
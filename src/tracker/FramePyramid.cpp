@@ -0,0 +1,113 @@
+// CSIRO has filed various patents which cover the Software. 
+
+// CSIRO grants to you a license to any patents granted for inventions
+// implemented by the Software for academic, research and non-commercial
+// use only.
+
+// CSIRO hereby reserves all rights to its inventions implemented by the
+// Software and any patents subsequently granted for those inventions
+// that are not expressly granted to you.  Should you wish to license the
+// patents relating to the Software for commercial use please contact
+// CSIRO IP & Licensing, Gautam Tendulkar (gautam.tendulkar@csiro.au) or
+// Nick Marsh (nick.marsh@csiro.au)
+
+// This software is provided under the CSIRO OPEN SOURCE LICENSE
+// (GPL2) which can be found in the LICENSE file located in the top
+// most directory of the source code.
+
+// Copyright CSIRO 2013
+
+#include <tracker/FramePyramid.hpp>
+using namespace FACETRACKER;
+using namespace std;
+//===========================================================================
+void FramePyramid::Reset(cv::Mat &im,cv::Rect roi)
+{
+  cv::Rect W(0,0,im.cols,im.rows);
+  im_ = im; roi_ = ((roi.width > 0) && (roi.height > 0)) ? (roi & W) : W;
+  frame_++; return;
+}
+//===========================================================================
+FramePyramid::Level& 
+FramePyramid::Find(int kind,double scale,int rows,int cols,int type)
+{
+  std::list<Level>::iterator it;
+  for(it = levels_.begin(); it != levels_.end(); ++it){
+    if((it->kind == kind) && (it->scale == scale))break;
+  }
+  if(it == levels_.end()){
+    Level l; l.kind = kind; l.scale = scale; l.frame = 0; 
+    it = levels_.insert(levels_.end(),l);
+  }
+  Level &l = *it;
+  if((l.im.rows != rows) || (l.im.cols != cols) || (l.im.type() != type)){
+    l.im.create(rows,cols,type); l.frame = 0;
+  }
+  if(l.frame != frame_){l.frame = frame_; l.valid = cv::Rect(0,0,0,0);}
+  return l;
+}
+//===========================================================================
+cv::Mat FramePyramid::Scaled(double scale,cv::Rect R)
+{
+  Level &l = this->Find(SCALED,scale,scale*im_.rows,scale*im_.cols,CV_8U);
+  R &= this->ScaledROI(scale);
+  if(((R & l.valid) == R) || (R.width <= 0) || (R.height <= 0))return l.im;
+  if(l.valid.width > 0)R |= l.valid;
+
+  //R as resizing the whole frame would give it, which samples the frame
+  //at ((x+0.5)*fx-0.5,(y+0.5)*fy-0.5) for level pixel (x,y)
+  double fx = double(im_.cols)/l.im.cols,fy = double(im_.rows)/l.im.rows;
+  double m[6] = {fx,0,(R.x+0.5)*fx-0.5,0,fy,(R.y+0.5)*fy-0.5};
+  cv::Mat M(2,3,CV_64F,m),dst = l.im(R);
+  cv::warpAffine(im_,dst,M,R.size(),cv::INTER_LINEAR|cv::WARP_INVERSE_MAP,
+		 cv::BORDER_REPLICATE);
+  l.valid = R; return l.im;
+}
+//===========================================================================
+cv::Rect FramePyramid::ScaledROI(double scale)
+{
+  int rows = scale*im_.rows,cols = scale*im_.cols;
+  if((rows <= 0) || (cols <= 0))return cv::Rect(0,0,0,0);
+
+  //level pixels whose bilinear samples read no row or column outside roi_,
+  //except where roi_ reaches the edge of the frame, which is replicated
+  double fx = double(im_.cols)/cols,fy = double(im_.rows)/rows;
+  int x1 = 0,y1 = 0,x2 = cols,y2 = rows;
+  if(roi_.x > 0)x1 = std::ceil((roi_.x + 0.5)/fx - 0.5);
+  if(roi_.y > 0)y1 = std::ceil((roi_.y + 0.5)/fy - 0.5);
+  if(roi_.x + roi_.width < im_.cols)
+    x2 = std::ceil((roi_.x + roi_.width - 0.5)/fx - 0.5);
+  if(roi_.y + roi_.height < im_.rows)
+    y2 = std::ceil((roi_.y + roi_.height - 0.5)/fy - 0.5);
+  if((x2 <= x1) || (y2 <= y1))return cv::Rect(0,0,0,0);
+  return cv::Rect(x1,y1,x2-x1,y2-y1) & cv::Rect(0,0,cols,rows);
+}
+//===========================================================================
+cv::Mat FramePyramid::Smooth(double scale)
+{
+  if(scale == 1)return im_;
+  Level &l = this->Find(SMOOTH,scale,im_.rows,im_.cols,CV_8U);
+  if(l.valid != roi_){
+    cv::Size ksize((1.0/scale)*3+1,(1.0/scale)*3+1);
+    cv::Mat dst = l.im(roi_);
+    cv::GaussianBlur(im_(roi_),dst,ksize,0,0,
+		     cv::BORDER_REPLICATE|cv::BORDER_ISOLATED); l.valid = roi_;
+  }return l.im;
+}
+//===========================================================================
+void FramePyramid::Gradients(double scale,cv::Mat &gx,cv::Mat &gy)
+{
+  cv::Mat im = this->Smooth(scale);
+  Level &lx = this->Find(GRADX,scale,im_.rows,im_.cols,CV_32F);
+  Level &ly = this->Find(GRADY,scale,im_.rows,im_.cols,CV_32F);
+  if(lx.valid != roi_){
+    cv::Mat dx = lx.im(roi_),dy = ly.im(roi_);
+    cv::Sobel(im(roi_),dx,CV_32F,1,0,3,1.0/8,0,
+	      cv::BORDER_REPLICATE|cv::BORDER_ISOLATED);
+    cv::Sobel(im(roi_),dy,CV_32F,0,1,3,1.0/8,0,
+	      cv::BORDER_REPLICATE|cv::BORDER_ISOLATED);
+    lx.valid = roi_; ly.valid = roi_;
+  }
+  gx = lx.im; gy = ly.im; return;
+}
+//===========================================================================
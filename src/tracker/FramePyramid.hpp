@@ -0,0 +1,69 @@
+// CSIRO has filed various patents which cover the Software. 
+
+// CSIRO grants to you a license to any patents granted for inventions
+// implemented by the Software for academic, research and non-commercial
+// use only.
+
+// CSIRO hereby reserves all rights to its inventions implemented by the
+// Software and any patents subsequently granted for those inventions
+// that are not expressly granted to you.  Should you wish to license the
+// patents relating to the Software for commercial use please contact
+// CSIRO IP & Licensing, Gautam Tendulkar (gautam.tendulkar@csiro.au) or
+// Nick Marsh (nick.marsh@csiro.au)
+
+// This software is provided under the CSIRO OPEN SOURCE LICENSE
+// (GPL2) which can be found in the LICENSE file located in the top
+// most directory of the source code.
+
+// Copyright CSIRO 2013
+
+#ifndef _TRACKER_FramePyramid_h_
+#define _TRACKER_FramePyramid_h_
+#include <tracker/IO.hpp>
+#include <list>
+namespace FACETRACKER
+{
+  //===========================================================================
+  /**
+     Scaled and filtered versions of one frame, computed on first request
+     and shared by the stages of the tracker until the next Reset. The
+     buffers are kept between frames so a steady state does not allocate.
+     Only the part of the frame given to Reset is assumed to be current,
+     and the filters are only run over it, replicating its border rather
+     than reading the pixels around it.
+  */
+  class FramePyramid{
+  public:
+    FramePyramid(){frame_ = 0;}
+
+    void 
+    Reset(cv::Mat &im,                       //greyscale frame
+	  cv::Rect roi = cv::Rect(0,0,0,0)); //current part, all if empty
+
+    inline cv::Mat& Image(){return im_;}
+    inline cv::Rect ROI(){return roi_;}
+
+    cv::Mat                  //frame resized by scale, R of it up to date
+    Scaled(double scale,     //scale, the level is int(scale*size) big
+	   cv::Rect R);      //area needed, clipped to ScaledROI(scale)
+    cv::Rect                 //part of Scaled(scale) computed from the
+    ScaledROI(double scale); //current part of the frame alone
+    cv::Mat                  //the frame itself when scale is 1
+    Smooth(double scale);    //Gaussian blur matched to a sampling scale
+    void
+    Gradients(double scale,  //of Smooth(scale), Sobel divided by 8
+	      cv::Mat &gx,   //contains x gradients (CV_32F) on return
+	      cv::Mat &gy);  //contains y gradients (CV_32F) on return
+  private:
+    enum{SCALED = 0,SMOOTH,GRADX,GRADY};
+    struct Level{
+      int kind; double scale; int64 frame; cv::Rect valid; cv::Mat im;
+    };
+    cv::Mat im_; cv::Rect roi_; int64 frame_; 
+    std::list<Level> levels_; //stable references as it grows
+
+    Level& Find(int kind,double scale,int rows,int cols,int type);
+  };
+  //===========================================================================
+}
+#endif
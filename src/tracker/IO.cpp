@@ -18,9 +18,19 @@
 // Copyright CSIRO 2013
 
 #include <tracker/IO.hpp>
+#include <tracker/Config.h>
 #include <stdio.h>
+#ifdef HAVE_MMAP
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 using namespace FACETRACKER;
 using namespace std;
+//stream slots holding the mapping base (pword) and data alignment (iword)
+static const int MAPPED_BASE  = std::ios_base::xalloc();
+static const int MAPPED_ALIGN = std::ios_base::xalloc();
 //===========================================================================
 vector<string> IO::GetList(const char* fname)
 {
@@ -229,16 +239,24 @@ std::vector<cv::Mat> IO::LoadMatList(const char* fname)
 //===========================================================================
 //===========================================================================
 //===========================================================================
-void IOBinary::ReadMat(std::ifstream &s, cv::Mat &M)
+void IOBinary::ReadMat(std::istream &s, cv::Mat &M)
 {
 	int r,c,t;
 	//s >> r >> c >> t;
 	s.read((char*)&r, sizeof(int));
 	s.read((char*)&c, sizeof(int));
 	s.read((char*)&t, sizeof(int));
-	M = cv::Mat(r,c,t);
-	s.read(reinterpret_cast<char*>(M.datastart), M.total()*M.elemSize());
-	
+	char* base = static_cast<char*>(s.pword(MAPPED_BASE));
+	if(base != NULL){
+	  //point into the mapping, data starts at the next aligned offset
+	  long align = s.iword(MAPPED_ALIGN);
+	  streamoff pos = s.tellg(); pos += (align - pos%align)%align;
+	  M = cv::Mat(r,c,t,base+pos);
+	  s.seekg(pos + streamoff(M.total()*M.elemSize()), ios_base::beg);
+	}else{
+	  M = cv::Mat(r,c,t);
+	  s.read(reinterpret_cast<char*>(M.datastart), M.total()*M.elemSize());
+	}
 	if(!s.good()){
 	  std::cout << "Error reading matrix" << std::endl;
 	}
@@ -254,11 +272,26 @@ void IOBinary::WriteMat(std::ofstream &s, cv::Mat &M)
 	s.write(reinterpret_cast<char*>(&M.cols), sizeof(int));
 	s.write(reinterpret_cast<char*>(&t), sizeof(int));
 	//	s << M.rows << " " << M.cols << " " << M.type();
+	long align = s.iword(MAPPED_ALIGN);
+	if(align > 0){
+	  static const char zeros[MAPPED_ALIGNMENT] = {0};
+	  streamoff pos = s.tellp();
+	  s.write(zeros, (align - pos%align)%align);
+	}
 	s.write(reinterpret_cast<char*>(M.datastart), M.total()*M.elemSize());
 
 	//	std::cout << "Mat written: "<< M.rows << "x"<< M.cols << ", type " << M.type() << std::endl; 
 
 }
+//===========================================================================
+void IOBinary::WriteMappedHeader(std::ofstream &s)
+{
+	int t = IOBinary::MAPPED, v = MAPPED_VERSION, a = MAPPED_ALIGNMENT;
+	s.write(reinterpret_cast<char*>(&t), sizeof(int));
+	s.write(reinterpret_cast<char*>(&v), sizeof(int));
+	s.write(reinterpret_cast<char*>(&a), sizeof(int));
+	s.iword(MAPPED_ALIGN) = a;
+}
 ////===========================================================================
 //cv::Mat IOBinary::LoadCon(const char *fname)
 //{
@@ -298,4 +331,77 @@ std::vector<cv::Mat> IOBinary::LoadMatList(const char *fname)
 	return L;
 }
 //===========================================================================
-
+//===========================================================================
+MappedFile::MappedFile(const char* fname) : s_(&buf_)
+{
+  data_ = heap_ = NULL; size_ = 0;
+#ifdef HAVE_MMAP
+  struct stat st; int fd = open(fname,O_RDONLY);
+  if((fd < 0) || (fstat(fd,&st) != 0)){
+    printf("ERROR(%s,%d) : Failed opening file %s for reading\n", 
+	   __FILE__,__LINE__,fname); abort();
+  }
+  //private writable mapping: pages are shared until someone writes to them
+  size_ = st.st_size;
+  void* p = mmap(NULL,size_,PROT_READ|PROT_WRITE,MAP_PRIVATE,fd,0); close(fd);
+  if(p == MAP_FAILED){
+    printf("ERROR(%s,%d) : Failed mapping file %s\n", 
+	   __FILE__,__LINE__,fname); abort();
+  }
+  data_ = static_cast<char*>(p);
+#else
+  //a copy of the file, starting at the same alignment a mapping would
+  ifstream f(fname,ios::binary);
+  if(!f.is_open()){
+    printf("ERROR(%s,%d) : Failed opening file %s for reading\n", 
+	   __FILE__,__LINE__,fname); abort();
+  }
+  f.seekg(0,ios::end); size_ = size_t(f.tellg()); f.seekg(0,ios::beg);
+  heap_ = new char[size_ + IOBinary::MAPPED_ALIGNMENT];
+  size_t align = size_t(IOBinary::MAPPED_ALIGNMENT);
+  data_ = heap_ + (align - size_t(heap_)%align)%align;
+  if(!f.read(data_,size_)){
+    printf("ERROR(%s,%d) : Failed reading file %s\n", 
+	   __FILE__,__LINE__,fname); abort();
+  }
+#endif
+  buf_.Init(data_,size_);
+  int t = -1,v = -1,a = -1;
+  s_.read(reinterpret_cast<char*>(&t), sizeof(int));
+  s_.read(reinterpret_cast<char*>(&v), sizeof(int));
+  s_.read(reinterpret_cast<char*>(&a), sizeof(int));
+  if((t != IOBinary::MAPPED) || (v != IOBinary::MAPPED_VERSION) || (a <= 0) ||
+     (IOBinary::MAPPED_ALIGNMENT%a != 0)){
+    printf("ERROR(%s,%d) : %s is not a mapped model file (version %d)\n", 
+	   __FILE__,__LINE__,fname,int(IOBinary::MAPPED_VERSION)); abort();
+  }
+  s_.pword(MAPPED_BASE) = data_; s_.iword(MAPPED_ALIGN) = a;
+}
+//===========================================================================
+MappedFile::~MappedFile()
+{
+#ifdef HAVE_MMAP
+  munmap(data_,size_);
+#else
+  delete[] heap_;
+#endif
+}
+//===========================================================================
+MappedFile::Buffer::pos_type 
+MappedFile::Buffer::seekoff(off_type off,std::ios_base::seekdir dir,
+			    std::ios_base::openmode /*which*/)
+{
+  char* p;
+  if(dir == std::ios_base::beg)p = this->eback() + off;
+  else if(dir == std::ios_base::cur)p = this->gptr() + off;
+  else p = this->egptr() + off;
+  if((p < this->eback()) || (p > this->egptr()))return pos_type(off_type(-1));
+  this->setg(this->eback(),p,this->egptr()); return pos_type(p-this->eback());
+}
+//===========================================================================
+MappedFile::Buffer::pos_type 
+MappedFile::Buffer::seekpos(pos_type pos,std::ios_base::openmode which)
+{
+  return this->seekoff(off_type(pos),std::ios_base::beg,which);
+}
+//===========================================================================
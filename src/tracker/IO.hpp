@@ -53,9 +53,11 @@ namespace FACETRACKER
   public:
     //    enum{IO_BINARY_DATA = 0xFFFF0000};
     enum{PDM3D= IO::DUMMY_LAST_DONT_USE+1,PAW,PATCH,MPATCH,CLM,FDET,FCHECK,MFCHECK,TRACKER,TPS,AAM_POIC,PDM2D,AAM_POIC_F,SINIT,LINPATCH,CLP,CLD,TRACKER4,NONLINPATCH,MIXPATCH,CLM3,CLMix,PRA,ATM_PO,LBPHISTPATCH,FACEPREDICTORPRA,FACEPREDICTORKSMOOTH,MYFACETRACKER,MYFACETRACKERPARAMS,REGOCHECK,MVREGOCHECK, SHAPEPREDICTORLIST, SHAPEPREDICTOR, SHAPEEXPMAP, KSMOOTH,
-	 DETECTOR_NCC, DETECTOR_HOG, DETECTOR_ASM, HOG_DET};
-    static void ReadMat(std::ifstream& s,cv::Mat &M);
+	 DETECTOR_NCC, DETECTOR_HOG, DETECTOR_ASM, HOG_DET, MAPPED};
+    enum{MAPPED_VERSION = 1, MAPPED_ALIGNMENT = 64};
+    static void ReadMat(std::istream& s,cv::Mat &M);
     static void WriteMat(std::ofstream& s,cv::Mat &M);
+    static void WriteMappedHeader(std::ofstream& s);
     //		static cv::Mat LoadCon(const char* fname);
     //		static cv::Mat LoadTri(const char* fname);
     //		static cv::Mat LoadVis(const char* fname);
@@ -68,6 +70,33 @@ namespace FACETRACKER
 		
 		
   };
-
+  //===========================================================================
+  /**
+     Memory mapping of a file written after IOBinary::WriteMappedHeader.
+     The file is read through Stream(), an input stream over the mapped
+     memory, and matrices read with IOBinary::ReadMat point straight into
+     the mapping instead of being copied, so the mapping must outlive
+     them. Without mmap (HAVE_MMAP) the file is read into memory instead.
+  */
+  class MappedFile{
+  public:
+    MappedFile(const char* fname);
+    ~MappedFile();
+    inline std::istream& Stream(){return s_;}
+    inline size_t Size(){return size_;}
+  private:
+    class Buffer : public std::streambuf{
+    public:
+      void Init(char* data,size_t size){this->setg(data,data,data+size);}
+    protected:
+      pos_type seekoff(off_type off,std::ios_base::seekdir dir,
+		       std::ios_base::openmode which);
+      pos_type seekpos(pos_type pos,std::ios_base::openmode which);
+    };
+    char* data_; size_t size_; char* heap_; Buffer buf_; std::istream s_;
+    MappedFile(MappedFile const&);
+    MappedFile& operator=(MappedFile const&);
+  };
+  //===========================================================================
 }
 #endif
@@ -0,0 +1,45 @@
+// CSIRO has filed various patents which cover the Software. 
+
+// CSIRO grants to you a license to any patents granted for inventions
+// implemented by the Software for academic, research and non-commercial
+// use only.
+
+// CSIRO hereby reserves all rights to its inventions implemented by the
+// Software and any patents subsequently granted for those inventions
+// that are not expressly granted to you.  Should you wish to license the
+// patents relating to the Software for commercial use please contact
+// CSIRO IP & Licensing, Gautam Tendulkar (gautam.tendulkar@csiro.au) or
+// Nick Marsh (nick.marsh@csiro.au)
+
+// This software is provided under the CSIRO OPEN SOURCE LICENSE
+// (GPL2) which can be found in the LICENSE file located in the top
+// most directory of the source code.
+
+// Copyright CSIRO 2013
+
+#include <tracker/MotionModel.hpp>
+#define db at<double>
+using namespace FACETRACKER;
+using namespace std;
+//===========================================================================
+void MotionModel::Predict(cv::Mat &plocal,cv::Mat &pglobl,
+			  double damping,bool local)
+{
+  if((n_ < 2) || (damping <= 0))return;
+  for(int i = 0; i < 4; i++)pglobl.db(i,0) += damping*vglobl_.db(i,0);
+  if(local){
+    for(int i = 0; i < plocal.rows; i++)
+      plocal.db(i,0) += damping*vlocal_.db(i,0);
+  }return;
+}
+//===========================================================================
+void MotionModel::Update(cv::Mat &plocal,cv::Mat &pglobl)
+{
+  if((n_ > 0) && 
+     ((plocal_.rows != plocal.rows) || (pglobl_.rows != pglobl.rows)))n_ = 0;
+  if(n_ > 0){
+    cv::subtract(plocal,plocal_,vlocal_); cv::subtract(pglobl,pglobl_,vglobl_);
+  }
+  plocal.copyTo(plocal_); pglobl.copyTo(pglobl_); n_ = min(n_+1,2); return;
+}
+//===========================================================================
@@ -0,0 +1,50 @@
+// CSIRO has filed various patents which cover the Software. 
+
+// CSIRO grants to you a license to any patents granted for inventions
+// implemented by the Software for academic, research and non-commercial
+// use only.
+
+// CSIRO hereby reserves all rights to its inventions implemented by the
+// Software and any patents subsequently granted for those inventions
+// that are not expressly granted to you.  Should you wish to license the
+// patents relating to the Software for commercial use please contact
+// CSIRO IP & Licensing, Gautam Tendulkar (gautam.tendulkar@csiro.au) or
+// Nick Marsh (nick.marsh@csiro.au)
+
+// This software is provided under the CSIRO OPEN SOURCE LICENSE
+// (GPL2) which can be found in the LICENSE file located in the top
+// most directory of the source code.
+
+// Copyright CSIRO 2013
+
+#ifndef _TRACKER_MotionModel_h_
+#define _TRACKER_MotionModel_h_
+#include <tracker/IO.hpp>
+namespace FACETRACKER
+{
+  //===========================================================================
+  /** 
+      Constant velocity model of the shape model parameters between
+      frames. The change in scale, rotation and (optionally) the local
+      parameters over the last frame is carried into the next one, 
+      damped, to start the fit closer to where the face now is. The
+      translation is left to the caller, who measures it directly.
+  */
+  class MotionModel{
+  public:
+    MotionModel(){this->Reset();}
+    void Reset(){n_ = 0;} //forget the motion, e.g. on re-initialisation
+    void 
+    Predict(cv::Mat &plocal,  //local parameters, updated if local
+	    cv::Mat &pglobl,  //global parameters, scale and rotation updated
+	    double damping,   //fraction of the last change carried over
+	    bool local);      //predict the local parameters too?
+    void 
+    Update(cv::Mat &plocal,   //parameters fitted to the current frame
+	   cv::Mat &pglobl);
+  private:
+    int n_; cv::Mat plocal_,pglobl_,vlocal_,vglobl_; //last fit, its change
+  };
+  //===========================================================================
+}
+#endif
@@ -0,0 +1,164 @@
+// CSIRO has filed various patents which cover the Software. 
+
+// CSIRO grants to you a license to any patents granted for inventions
+// implemented by the Software for academic, research and non-commercial
+// use only.
+
+// CSIRO hereby reserves all rights to its inventions implemented by the
+// Software and any patents subsequently granted for those inventions
+// that are not expressly granted to you.  Should you wish to license the
+// patents relating to the Software for commercial use please contact
+// CSIRO IP & Licensing, Gautam Tendulkar (gautam.tendulkar@csiro.au) or
+// Nick Marsh (nick.marsh@csiro.au)
+
+// This software is provided under the CSIRO OPEN SOURCE LICENSE
+// (GPL2) which can be found in the LICENSE file located in the top
+// most directory of the source code.
+
+// Copyright CSIRO 2013
+
+#include <tracker/MultiFaceTracker.hpp>
+#include <tracker/ThreadPool.hpp>
+#define db at<double>
+using namespace FACETRACKER;
+using namespace std;
+//==============================================================================
+//tracks each face on the frame, from its box if any is given
+struct FaceBody : public ParallelBody{
+  vector<TrackedFace*> &faces; vector<cv::Rect>* rect; cv::Mat &im; 
+  FaceTrackerParams* params;
+  FaceBody(vector<TrackedFace*> &f,vector<cv::Rect>* r,cv::Mat &i,
+	   FaceTrackerParams* p) : faces(f),rect(r),im(i),params(p){;}
+  void operator()(int begin,int end){
+    for(int i = begin; i < end; i++){
+      if(rect)faces[i]->_health = 
+		faces[i]->_tracker.NewFrame(im,(*rect)[i],params);
+      else faces[i]->_health = faces[i]->_tracker.NewFrame(im,params);
+    }return;
+  }
+};
+//==============================================================================
+static cv::Rect 
+ShapeRect(cv::Mat &s)
+{
+  int i,n = s.rows/2; double vx,vy;
+  if(n == 0)return cv::Rect(0,0,0,0);
+  double xmax=s.db(0,0),ymax=s.db(n,0),xmin=xmax,ymin=ymax;
+  for(i = 1; i < n; i++){
+    vx = s.db(i,0); vy = s.db(i+n,0);
+    xmax = std::max(xmax,vx); ymax = std::max(ymax,vy);
+    xmin = std::min(xmin,vx); ymin = std::min(ymin,vy);
+  }
+  return cv::Rect(xmin,ymin,xmax-xmin,ymax-ymin);
+}
+//==============================================================================
+static bool 
+SameFace(cv::Rect &a,cv::Rect &b)
+{
+  cv::Point ca(a.x+a.width/2,a.y+a.height/2),cb(b.x+b.width/2,b.y+b.height/2);
+  return a.contains(cb) || b.contains(ca);
+}
+//==============================================================================
+MultiFaceTracker::MultiFaceTracker()
+{
+  _max_faces = 6; _detect_every = 10; _min_health = 5;
+  frame_ = 0; next_id_ = 0;
+}
+//==============================================================================
+MultiFaceTracker::MultiFaceTracker(const char* fname)
+{
+  _max_faces = 6; _detect_every = 10; _min_health = 5;
+  frame_ = 0; next_id_ = 0; this->Load(fname);
+}
+//==============================================================================
+MultiFaceTracker::MultiFaceTracker(cv::Ptr<TrackerModel> model)
+{
+  _max_faces = 6; _detect_every = 10; _min_health = 5;
+  frame_ = 0; next_id_ = 0; _model = model;
+}
+//==============================================================================
+MultiFaceTracker::~MultiFaceTracker()
+{
+  this->Reset();
+}
+//==============================================================================
+void 
+MultiFaceTracker::Load(const char* fname)
+{
+  this->Reset(); _model = LoadTrackerModel(fname); return;
+}
+//==============================================================================
+void 
+MultiFaceTracker::Reset()
+{
+  for(size_t i = 0; i < _faces.size(); i++)delete _faces[i];
+  _faces.clear(); frame_ = 0; return;
+}
+//==============================================================================
+int
+MultiFaceTracker::Track(cv::Mat &im,
+			FaceTrackerParams* params)
+{
+  assert(!_model.empty()); int i,n;
+
+  //convert image to greyscale once for all faces
+  if(im.channels() == 1)gray_ = im;
+  else{
+    if((gray_.rows != im.rows) || (gray_.cols != im.cols))
+      gray_.create(im.rows,im.cols,CV_8U);
+    cv::cvtColor(im,gray_,CV_BGR2GRAY);
+  }
+  //track existing faces
+  n = _faces.size();
+  {FaceBody body(_faces,NULL,gray_,params); ParallelFor(0,n,body);}
+  this->Prune();
+
+  //search for faces entering the frame
+  if((int(_faces.size()) < _max_faces) && 
+     ((_faces.size() == 0) || (frame_ % std::max(_detect_every,1) == 0))){
+    vector<cv::Rect> det = _model->DetectAll(gray_),rect;
+    vector<TrackedFace*> born;
+    for(i = 0; i < int(det.size()); i++){
+      if(int(_faces.size()+born.size()) >= _max_faces)break;
+      if(this->Covered(det[i]))continue;
+      born.push_back(new TrackedFace(_model)); rect.push_back(det[i]);
+    }
+    n = born.size();
+    {FaceBody body(born,&rect,gray_,params); ParallelFor(0,n,body);}
+    for(i = 0; i < n; i++){
+      if(born[i]->_health >= _min_health){
+	born[i]->_id = next_id_++; _faces.push_back(born[i]);
+      }else delete born[i];
+    }
+    this->Prune();
+  }
+  frame_++; return _faces.size();
+}
+//==============================================================================
+void 
+MultiFaceTracker::Prune()
+{
+  //drop faces that were lost
+  vector<TrackedFace*> faces;
+  for(size_t i = 0; i < _faces.size(); i++){
+    if(_faces[i]->_health >= _min_health)faces.push_back(_faces[i]);
+    else delete _faces[i];
+  }
+  //drop the newer of two faces that converged onto the same person
+  _faces.clear();
+  for(size_t i = 0; i < faces.size(); i++){
+    cv::Rect r = ShapeRect(faces[i]->_tracker._shape);
+    if(this->Covered(r))delete faces[i];
+    else _faces.push_back(faces[i]);
+  }return;
+}
+//==============================================================================
+bool
+MultiFaceTracker::Covered(cv::Rect &r)
+{
+  for(size_t i = 0; i < _faces.size(); i++){
+    cv::Rect f = ShapeRect(_faces[i]->_tracker._shape);
+    if(SameFace(r,f))return true;
+  }return false;
+}
+//==============================================================================
@@ -0,0 +1,76 @@
+// CSIRO has filed various patents which cover the Software. 
+
+// CSIRO grants to you a license to any patents granted for inventions
+// implemented by the Software for academic, research and non-commercial
+// use only.
+
+// CSIRO hereby reserves all rights to its inventions implemented by the
+// Software and any patents subsequently granted for those inventions
+// that are not expressly granted to you.  Should you wish to license the
+// patents relating to the Software for commercial use please contact
+// CSIRO IP & Licensing, Gautam Tendulkar (gautam.tendulkar@csiro.au) or
+// Nick Marsh (nick.marsh@csiro.au)
+
+// This software is provided under the CSIRO OPEN SOURCE LICENSE
+// (GPL2) which can be found in the LICENSE file located in the top
+// most directory of the source code.
+
+// Copyright CSIRO 2013
+
+#ifndef _TRACKER_MultiFaceTracker_h_
+#define _TRACKER_MultiFaceTracker_h_
+#include <tracker/TrackerModel.hpp>
+#include <vector>
+namespace FACETRACKER
+{
+  //============================================================================
+  /**
+     A face tracked by MultiFaceTracker
+  */
+  class TrackedFace{
+  public:
+    int _id;                 /**< Identifier, unique for the tracker lifetime */
+    int _health;             /**< Health of the last fit                      */
+    TrackerSession _tracker; /**< Tracking state of this face                 */
+
+    TrackedFace(cv::Ptr<TrackerModel> model) : _tracker(model){
+      _id = -1; _health = -1;
+    }
+  };
+  //============================================================================
+  /**
+     Tracks several faces at once. The CLM, shape initialiser, failure checker
+     and shape predictors are loaded once and shared read-only between the
+     faces, each of which only owns its fitting state.
+  */
+  class MultiFaceTracker{
+  public:
+    cv::Ptr<TrackerModel> _model;     /**< Model shared by all faces         */
+    int _max_faces;                   /**< Maximum number of faces tracked   */
+    int _detect_every;                /**< Frames between face searches      */
+    int _min_health;                  /**< Faces below this health are lost  */
+    std::vector<TrackedFace*> _faces; /**< Faces currently tracked           */
+
+    MultiFaceTracker();
+    MultiFaceTracker(const char* fname); //file containing facetracker model
+    MultiFaceTracker(cv::Ptr<TrackerModel> model); //already loaded model
+    ~MultiFaceTracker();
+    void Load(const char* fname);
+    void Reset(); //forget all faces
+
+    int                                //number of faces tracked
+    Track(cv::Mat &im,                 //image to track
+	  FaceTrackerParams* params=NULL); //additional parameters
+
+    inline int nFaces(){return _faces.size();}
+  protected:
+    int frame_,next_id_; cv::Mat gray_;
+    void Prune();
+    bool Covered(cv::Rect &r);
+  private:
+    MultiFaceTracker(MultiFaceTracker const&);
+    MultiFaceTracker& operator=(MultiFaceTracker const&);
+  };
+  //============================================================================
+}
+#endif
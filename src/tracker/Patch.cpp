@@ -18,7 +18,6 @@
 // Copyright CSIRO 2013
 
 #include <tracker/Patch.hpp>
-#define SGN(x) ((x<0) ? 0:1)
 using namespace FACETRACKER;
 using namespace std;
 //===========================================================================
@@ -45,49 +44,6 @@ void sum2one(cv::Mat &M)
 	   __FILE__,__LINE__,M.type()); abort();
   }return;
 }
-//===========================================================================
-void Grad(cv::Mat &im,cv::Mat &grad)
-{
-  assert((im.rows == grad.rows) && (im.cols == grad.cols));
-  assert((im.type() == CV_32F) && (grad.type() == CV_32F));
-  int x,y,h = im.rows,w = im.cols; float vx,vy; grad = cv::Scalar(0);
-  cv::MatIterator_<float> gp  = grad.begin<float>() + w+1;
-  cv::MatIterator_<float> px1 = im.begin<float>()   + w+2;
-  cv::MatIterator_<float> px2 = im.begin<float>()   + w;
-  cv::MatIterator_<float> py1 = im.begin<float>()   + 2*w+1;
-  cv::MatIterator_<float> py2 = im.begin<float>()   + 1;
-  for(y = 1; y < h-1; y++){ 
-    for(x = 1; x < w-1; x++){
-      vx = *px1++ - *px2++; vy = *py1++ - *py2++; *gp++ = vx*vx + vy*vy;
-    }
-    px1 += 2; px2 += 2; py1 += 2; py2 += 2; gp += 2;
-  }return;
-}
-//===========================================================================
-void LBP(cv::Mat &im,cv::Mat &lbp)
-{
-  assert((im.rows == lbp.rows) && (im.cols == lbp.cols));
-  assert((im.type() == CV_32F) && (lbp.type() == CV_32F));
-  int x,y,h = im.rows,w = im.cols; float v[9]; lbp = cv::Scalar(0);
-  cv::MatIterator_<float> lp = lbp.begin<float>() + w+1;
-  cv::MatIterator_<float> p1 = im.begin<float>();
-  cv::MatIterator_<float> p2 = im.begin<float>()  + w;
-  cv::MatIterator_<float> p3 = im.begin<float>()  + w*2;
- for(y = 1; y < h-1; y++){
-    for(x = 1; x < w-1; x++){
-      v[4] = *p2++; v[0] = *p2++; v[5] = *p2;
-      v[1] = *p1++; v[2] = *p1++; v[3] = *p1;
-      v[6] = *p3++; v[7] = *p3++; v[8] = *p3;
-      *lp++ = 
-	SGN(v[0]-v[1])*2   + SGN(v[0]-v[2])*4   + 
-	SGN(v[0]-v[3])*8   + SGN(v[0]-v[4])*16  + 
-	SGN(v[0]-v[5])*32  + SGN(v[0]-v[6])*64  + 
-	SGN(v[0]-v[7])*128 + SGN(v[0]-v[8])*256 ;
-      p1--; p2--; p3--;
-    }
-    p1 += 2; p2 += 2; p3 += 2; lp += 2;
-  }return;
-}
 //=============================================================================
 //=============================================================================
 //=============================================================================
@@ -103,6 +59,12 @@ Patch& Patch::operator= (Patch const& rhs)
   this->res_ = rhs.res_.clone(); return *this;
 }
 //===========================================================================
+void Patch::Share(Patch const& rhs)
+{
+  _t = rhs._t; _a = rhs._a; _b = rhs._b; _W = rhs._W; 
+  im_.release(); res_.release(); ncc_ = NCC(); return;
+}
+//===========================================================================
 void Patch::Load(const char* fname, bool binary)
 {
   ifstream s;
@@ -144,7 +106,7 @@ void Patch::Read(ifstream &s,bool readType)
   return;
 }
 //===========================================================================
-void Patch::ReadBinary(ifstream &s,bool readType)
+void Patch::ReadBinary(istream &s,bool readType)
 
 {
   if(readType){int type; 
@@ -163,33 +125,36 @@ void Patch::Init(int t, double a, double b, cv::Mat &W)
 {
   assert((W.type() == CV_32F)); _t=t; _a=a; _b=b; _W=W.clone(); return;
 }
-//===========================================================================
-void Patch::Response(cv::Mat &im,cv::Mat &resp)
+//feature channel t of im, computed into mem unless raw
+static cv::Mat Feature(cv::Mat &im,int t,cv::Mat &mem)
 {
-  assert((im.type() == CV_32F) && (resp.type() == CV_64F));
-  assert((im.rows>=_W.rows) && (im.cols>=_W.cols));
-  int h = im.rows - _W.rows + 1, w = im.cols - _W.cols + 1; cv::Mat I;
-  if(resp.rows != h || resp.cols != w)resp.create(h,w,CV_64F);
-  if(res_.rows != h || res_.cols != w)res_.create(h,w,CV_32F);
-  if(_t == 0)I = im;
+  if(t == 0)return im;
+  cv::Mat I;
+  if(mem.rows == im.rows && mem.cols == im.cols)I = mem;
+  else if(mem.rows >= im.rows && mem.cols >= im.cols)
+    I = mem(cv::Rect(0,0,im.cols,im.rows));
+  else{mem.create(im.rows,im.cols,CV_32F); I = mem;}
+  if     (t == 1)Grad(im,I);
+  else if(t == 2)LBP(im,I);
   else{
-    if(im_.rows == im.rows && im_.cols == im.cols)I = im_;
-    else if(im_.rows >= im.rows && im_.cols >= im.cols)
-      I = im_(cv::Rect(0,0,im.cols,im.rows));
-    else{im_.create(im.rows,im.cols,CV_32F); I = im_;}
-    if     (_t == 1)Grad(im,I);
-    else if(_t == 2)LBP(im,I);
-    else{
-      printf("ERROR(%s,%d): Unsupported patch type %d!\n",
-	     __FILE__,__LINE__,_t); abort();
-    }
+    printf("ERROR(%s,%d): Unsupported patch type %d!\n",
+	   __FILE__,__LINE__,t); abort();
   }
-  cv::matchTemplate(I,_W,res_,CV_TM_CCOEFF_NORMED);
-  cv::MatIterator_<double> p = resp.begin<double>();
-  cv::MatIterator_<float> q1 = res_.begin<float>();
-  cv::MatIterator_<float> q2 = res_.end<float>();
-  while(q1 != q2)*p++ = 1.0/(1.0 + exp( *q1++ * _a + _b ));
-  return;
+  return I;
+}
+//===========================================================================
+void Patch::Response(cv::Mat &im,cv::Mat &resp)
+{
+  assert(im.type() == CV_32F);
+  cv::Mat I = Feature(im,_t,im_); this->FeatureResponse(I,resp); return;
+}
+//===========================================================================
+void Patch::FeatureResponse(cv::Mat &f,cv::Mat &resp)
+{
+  assert((f.type() == CV_32F) && 
+	 ((resp.type() == CV_32F) || (resp.type() == CV_64F)));
+  assert((f.rows>=_W.rows) && (f.cols>=_W.cols));
+  ncc_.Response(f,_W,_a,_b,res_,resp); return;
 }
 //===========================================================================
 //===========================================================================
@@ -210,6 +175,13 @@ MPatch& MPatch::operator= (MPatch const& rhs)
   _p = rhs._p; return *this;
 }
 //===========================================================================
+void MPatch::Share(MPatch const& rhs)
+{
+  _w = rhs._w; _h = rhs._h; _p.resize(rhs._p.size());
+  for(size_t i = 0; i < rhs._p.size(); i++)_p[i].Share(rhs._p[i]);
+  res_.release(); grad_.release(); lbp_.release(); return;
+}
+//===========================================================================
 void MPatch::Init(std::vector<Patch> &p)
 {
   _w = p[0]._W.cols; _h = p[0]._W.rows;
@@ -270,7 +242,7 @@ void MPatch::Read(ifstream &s,bool readType)
   return;
 }
 //===========================================================================
-void MPatch::ReadBinary(ifstream &s,bool readType)
+void MPatch::ReadBinary(istream &s,bool readType)
 {
   if(readType){int type; 
     s.read(reinterpret_cast<char*>(&type), sizeof(type));
@@ -293,18 +265,113 @@ void MPatch::ReadBinary(ifstream &s,bool readType)
 //===========================================================================
 void MPatch::Response(cv::Mat &im,cv::Mat &resp)
 {
-  assert((im.type() == CV_32F) && (resp.type() == CV_64F));
+  assert((im.type() == CV_32F) && 
+	 ((resp.type() == CV_32F) || (resp.type() == CV_64F)));
   assert((im.rows >= _h) && (im.cols >= _w));
-  int h = im.rows - _h + 1, w = im.cols - _w + 1;
-  if(resp.rows != h || resp.cols != w)resp.create(h,w,CV_64F);
-  if(res_.rows != h || res_.cols != w)res_.create(h,w,CV_64F);
-  if(_p.size() == 1){_p[0].Response(im,resp); sum2one(resp);}
+  int h = im.rows - _h + 1, w = im.cols - _w + 1,type = resp.type();
+  if(resp.rows != h || resp.cols != w)resp.create(h,w,type);
+  if(res_.rows != h || res_.cols != w || res_.type() != type)
+    res_.create(h,w,type);
+  //each channel is computed at most once and shared by the patches using it
+  cv::Mat F[3]; F[0] = im;
+  for(size_t i = 0; i < _p.size(); i++){
+    int t = _p[i]._t;
+    if((t < 0) || (t > 2)){
+      printf("ERROR(%s,%d): Unsupported patch type %d!\n",
+	     __FILE__,__LINE__,t); abort();
+    }
+    if(F[t].empty())F[t] = Feature(im,t,(t == 1) ? grad_ : lbp_);
+  }
+  if(_p.size() == 1){_p[0].FeatureResponse(F[_p[0]._t],resp); sum2one(resp);}
   else{
     resp = cvScalar(1.0);
     for(size_t i = 0; i < _p.size(); i++){
-      _p[i].Response(im,res_); sum2one(res_); resp = resp.mul(res_);
+      _p[i].FeatureResponse(F[_p[i]._t],res_); 
+      sum2one(res_); cv::multiply(resp,res_,resp);
     }
     sum2one(resp); 
   }return;
 }
 //=============================================================================
+//=============================================================================
+//=============================================================================
+//=============================================================================
+//=============================================================================
+//=============================================================================
+//=============================================================================
+//=============================================================================
+void PatchBank::Pack(std::vector<MPatch> &p)
+{
+  int i,j,k,x,y,n = p.size(),np = 0,nw = 0;
+  for(i = 0; i < n; i++){
+    np += p[i]._p.size(); 
+    nw += p[i]._p.size()*((p[i]._w*p[i]._h + 7) & ~7);
+  }
+  //arrays first, 8 byte entries before 4 byte ones, then the gains
+  size_t head = 3*np*sizeof(double) + (2*np + 4*n + 1)*sizeof(int);
+  head = (head + 31) & ~size_t(31);
+  data_.release(); //copies keep the old block
+  data_.create(1,head + nw*sizeof(float) + 32,CV_8U);
+  uchar* base = (uchar*)(((size_t)data_.data + 31) & ~size_t(31));
+  a_ = (double*)base; b_ = a_ + np; norm_ = b_ + np;
+  type_ = (int*)(norm_ + np); off_ = type_ + np; 
+  first_ = off_ + np; w_ = first_ + n + 1; h_ = w_ + n; chan_ = h_ + n;
+  gain_ = (float*)(base + head); n_ = n;
+
+  for(i = 0,k = 0,nw = 0; i < n; i++){
+    first_[i] = k; w_[i] = p[i]._w; h_[i] = p[i]._h; chan_[i] = 0;
+    for(j = 0; j < int(p[i]._p.size()); j++,k++){
+      Patch &P = p[i]._p[j]; cv::Mat &W = P._W;
+      if((P._t < 0) || (P._t > 2)){
+	printf("ERROR(%s,%d): Unsupported patch type %d!\n",
+	       __FILE__,__LINE__,P._t); abort();
+      }
+      a_[k] = P._a; b_[k] = P._b; type_[k] = P._t; off_[k] = nw; 
+      chan_[i] |= 1 << P._t;
+
+      //zero mean gain, as NCC::Correlate makes it
+      double mean = 0,tnorm = 0; float* g = gain_ + nw;
+      for(y = 0; y < W.rows; y++){
+	const float* wp = W.ptr<float>(y);
+	for(x = 0; x < W.cols; x++)mean += wp[x];
+      }
+      mean /= W.rows*W.cols;
+      for(y = 0; y < W.rows; y++){
+	const float* wp = W.ptr<float>(y);
+	for(x = 0; x < W.cols; x++){
+	  double v = wp[x] - mean; *g++ = v; tnorm += v*v;
+	}
+      }
+      norm_[k] = sqrt(tnorm); nw += (W.rows*W.cols + 7) & ~7;
+    }
+  }
+  first_[n] = k; return;
+}
+//===========================================================================
+void PatchBank::Response(int i,cv::Mat &im,cv::Mat &resp,Scratch &mem)
+{
+  assert((i >= 0) && (i < n_));
+  assert((im.type() == CV_32F) && 
+	 ((resp.type() == CV_32F) || (resp.type() == CV_64F)));
+  assert((im.rows >= h_[i]) && (im.cols >= w_[i]));
+  int h = im.rows - h_[i] + 1, w = im.cols - w_[i] + 1,type = resp.type();
+  if(resp.rows != h || resp.cols != w)resp.create(h,w,type);
+  if(mem.res.rows != h || mem.res.cols != w || mem.res.type() != type)
+    mem.res.create(h,w,type);
+
+  //each channel the point uses, computed once
+  cv::Mat F[3]; F[0] = im;
+  if(chan_[i] & 2)F[1] = Feature(im,1,mem.grad);
+  if(chan_[i] & 4)F[2] = Feature(im,2,mem.lbp);
+
+  int k0 = first_[i],k1 = first_[i+1];
+  for(int k = k0; k < k1; k++){
+    cv::Mat T(h_[i],w_[i],CV_32F,gain_ + off_[k]);
+    cv::Mat &R = (k == k0) ? resp : mem.res;
+    mem.ncc.Response(F[type_[k]],T,norm_[k],a_[k],b_[k],mem.corr,R);
+    sum2one(R); if(k > k0)cv::multiply(resp,R,resp);
+  }
+  if(k1 - k0 > 1)sum2one(resp); 
+  return;
+}
+//=============================================================================
@@ -20,6 +20,7 @@
 #ifndef _TRACKER_Patch_h_
 #define _TRACKER_Patch_h_
 #include <tracker/IO.hpp>
+#include <tracker/PatchKernels.hpp>
 namespace FACETRACKER
 {
   //===========================================================================
@@ -37,18 +38,21 @@ namespace FACETRACKER
     Patch(const char* fname, bool binary = false){this->Load(fname, binary);}
     Patch(int t,double a,double b,cv::Mat &W){this->Init(t,a,b,W);}
     Patch& operator=(Patch const&rhs);
+    void Share(Patch const&rhs); /**< share gain, own scratch memory */
     inline int w(){return _W.cols;}
     inline int h(){return _W.rows;}
     void Load(const char* fname, bool binary = false);
     void Save(const char* fname, bool binary = false);
     void Write(std::ofstream &s, bool binary = false);
     void Read(std::ifstream &s,bool readType = true);
-    void ReadBinary(std::ifstream &s,bool readType = true);
+    void ReadBinary(std::istream &s,bool readType = true);
     void Init(int t, double a, double b, cv::Mat &W);
     void Response(cv::Mat &im,cv::Mat &resp);    
+    void FeatureResponse(cv::Mat &f,       //window already transformed by _t
+			 cv::Mat &resp);   //as for Response
     cv::Mat Response(){return res_.clone();}
   private:
-    cv::Mat im_,res_;
+    cv::Mat im_,res_; NCC ncc_;
   };
   //===========================================================================
   /**
@@ -63,16 +67,46 @@ namespace FACETRACKER
     MPatch(const char* fname, bool binary = false){this->Load(fname, binary);}
     MPatch(std::vector<Patch> &p){this->Init(p);}
     MPatch& operator=(MPatch const&rhs);
+    void Share(MPatch const&rhs); /**< share gains, own scratch memory */
     inline int nPatch(){return _p.size();}
     void Load(const char* fname, bool binary = false);
     void Save(const char* fname, bool binary = false);
     void Write(std::ofstream &s, bool binary = false);
     void Read(std::ifstream &s,bool readType = true);
-    void ReadBinary(std::ifstream &s,bool readType = true);
+    void ReadBinary(std::istream &s,bool readType = true);
     void Init(std::vector<Patch> &p);
-    void Response(cv::Mat &im,cv::Mat &resp);    
+    void Response(cv::Mat &im,cv::Mat &resp); /**< channels computed once */
+  private:
+    cv::Mat res_,grad_,lbp_;
+  };
+  //===========================================================================
+  /**
+     The multi-patch experts of all points of a view packed into one
+     aligned block for the response loop: the logistic parameters,
+     template norms, types and gain offsets of every patch as arrays,
+     the patch range, size and channels of every point, and the zero
+     mean gains, each starting on a 32 byte boundary. Copies share the
+     block, which is never written after Pack: packing again gives this
+     bank a new block and leaves the copies with the old one.
+  */
+  class PatchBank{
+  public:
+    struct Scratch{NCC ncc; cv::Mat corr,res,grad,lbp;}; //one per point
+
+    PatchBank(){n_ = 0;}
+    void Pack(std::vector<MPatch> &p); //experts of each point
+    inline int nPoints(){return n_;}
+    void 
+    Response(int i,         //point
+	     cv::Mat &im,   //window about it (CV_32F)
+	     cv::Mat &resp, //as for MPatch::Response
+	     Scratch &mem);
   private:
-    cv::Mat res_;
+    cv::Mat data_; int n_;
+    double *a_,*b_,*norm_; //per patch
+    int *type_,*off_;      //per patch, off_ in floats from gain_
+    int *first_,*w_,*h_,*chan_; //per point, first_ has n_+1 entries
+    float* gain_;
   };
   //===========================================================================
 }
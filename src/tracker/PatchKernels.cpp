@@ -0,0 +1,512 @@
+// CSIRO has filed various patents which cover the Software. 
+
+// CSIRO grants to you a license to any patents granted for inventions
+// implemented by the Software for academic, research and non-commercial
+// use only.
+
+// CSIRO hereby reserves all rights to its inventions implemented by the
+// Software and any patents subsequently granted for those inventions
+// that are not expressly granted to you.  Should you wish to license the
+// patents relating to the Software for commercial use please contact
+// CSIRO IP & Licensing, Gautam Tendulkar (gautam.tendulkar@csiro.au) or
+// Nick Marsh (nick.marsh@csiro.au)
+
+// This software is provided under the CSIRO OPEN SOURCE LICENSE
+// (GPL2) which can be found in the LICENSE file located in the top
+// most directory of the source code.
+
+// Copyright CSIRO 2013
+
+#include <tracker/PatchKernels.hpp>
+#include <tracker/ThreadPool.hpp>
+#include <cfloat>
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__clang__) || \
+     (__GNUC__ > 4) || ((__GNUC__ == 4) && (__GNUC_MINOR__ >= 9)))
+#define NCC_AVX2
+#include <immintrin.h>
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define NCC_NEON
+#include <arm_neon.h>
+#endif
+using namespace FACETRACKER;
+using namespace std;
+//===========================================================================
+// Correlation kernels: R(y,x) = sum_{j,i} T(j,i)*I(y+j,x+i) for an h x w 
+// result. Rows of I are istep floats apart, T and R are continuous.
+//===========================================================================
+static void 
+CorrScalar(const float* I,int istep,const float* T,int tw,int th,
+	   float* R,int w,int h)
+{
+  for(int y = 0; y < h; y++){
+    for(int x = 0; x < w; x++){
+      float v = 0;
+      for(int j = 0; j < th; j++){
+	const float* ip = I + (y+j)*istep + x; const float* tp = T + j*tw;
+	for(int i = 0; i < tw; i++)v += tp[i]*ip[i];
+      }
+      R[y*w+x] = v;
+    }
+  }return;
+}
+//===========================================================================
+#ifdef NCC_AVX2
+__attribute__((target("avx2,fma"))) static void 
+CorrAVX2(const float* I,int istep,const float* T,int tw,int th,
+	 float* R,int w,int h)
+{
+  for(int y = 0; y < h; y++){
+    int x = 0;
+    for(; x+8 <= w; x += 8){
+      __m256 acc = _mm256_setzero_ps();
+      for(int j = 0; j < th; j++){
+	const float* ip = I + (y+j)*istep + x; const float* tp = T + j*tw;
+	for(int i = 0; i < tw; i++)
+	  acc = _mm256_fmadd_ps(_mm256_set1_ps(tp[i]),_mm256_loadu_ps(ip+i),acc);
+      }
+      _mm256_storeu_ps(R+y*w+x,acc);
+    }
+    for(; x < w; x++){
+      float v = 0;
+      for(int j = 0; j < th; j++){
+	const float* ip = I + (y+j)*istep + x; const float* tp = T + j*tw;
+	for(int i = 0; i < tw; i++)v += tp[i]*ip[i];
+      }
+      R[y*w+x] = v;
+    }
+  }return;
+}
+#endif
+//===========================================================================
+#ifdef NCC_NEON
+static void 
+CorrNEON(const float* I,int istep,const float* T,int tw,int th,
+	 float* R,int w,int h)
+{
+  for(int y = 0; y < h; y++){
+    int x = 0;
+    for(; x+4 <= w; x += 4){
+      float32x4_t acc = vdupq_n_f32(0);
+      for(int j = 0; j < th; j++){
+	const float* ip = I + (y+j)*istep + x; const float* tp = T + j*tw;
+	for(int i = 0; i < tw; i++)acc = vmlaq_n_f32(acc,vld1q_f32(ip+i),tp[i]);
+      }
+      vst1q_f32(R+y*w+x,acc);
+    }
+    for(; x < w; x++){
+      float v = 0;
+      for(int j = 0; j < th; j++){
+	const float* ip = I + (y+j)*istep + x; const float* tp = T + j*tw;
+	for(int i = 0; i < tw; i++)v += tp[i]*ip[i];
+      }
+      R[y*w+x] = v;
+    }
+  }return;
+}
+#endif
+//===========================================================================
+static bool 
+KernelSupported(int kernel)
+{
+  switch(kernel){
+  case KERNEL_OPENCV: 
+  case KERNEL_SCALAR: return true;
+#ifdef NCC_AVX2
+  case KERNEL_AVX2: 
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+#ifdef NCC_NEON
+  case KERNEL_NEON: return true;
+#endif
+  default: return false;
+  }
+}
+//===========================================================================
+static int 
+BestKernel()
+{
+  if(KernelSupported(KERNEL_AVX2))return KERNEL_AVX2;
+  if(KernelSupported(KERNEL_NEON))return KERNEL_NEON;
+  return KERNEL_SCALAR;
+}
+//===========================================================================
+static int kernel_ = BestKernel();
+//===========================================================================
+int FACETRACKER::PatchKernel()
+{
+  return kernel_;
+}
+//===========================================================================
+bool FACETRACKER::SetPatchKernel(int kernel)
+{
+  if(!KernelSupported(kernel))return false; kernel_ = kernel; return true;
+}
+//===========================================================================
+// Feature kernels for row y of the interior of an image with istep floats
+// between rows: G(x) = (I(x+1)-I(x-1))^2 + (I(x+istep)-I(x-istep))^2 and 
+// L(x) = sum_k 2^k [I(x) >= I(x+n_k)] over the 8 neighbours n_k, matching 
+// the SGN() of the original implementation. Both are written for 
+// x = 1..w-2, with I, G and L pointing at the start of the row.
+//===========================================================================
+static const int LBP_BIT[8] = {2,4,8,16,32,64,128,256}; //by neighbour below
+static inline void 
+LBPOffsets(int istep,int off[8])
+{
+  off[0] = -istep-1; off[1] = -istep; off[2] = -istep+1; off[3] = -1; 
+  off[4] = 1; off[5] = istep-1; off[6] = istep; off[7] = istep+1; return;
+}
+//===========================================================================
+static void 
+GradScalar(const float* I,int istep,float* G,int w)
+{
+  for(int x = 1; x < w-1; x++){
+    float vx = I[x+1] - I[x-1],vy = I[x+istep] - I[x-istep];
+    G[x] = vx*vx + vy*vy;
+  }return;
+}
+//===========================================================================
+static void 
+LBPScalar(const float* I,int istep,float* L,int w)
+{
+  int k,off[8]; LBPOffsets(istep,off);
+  for(int x = 1; x < w-1; x++){
+    int v = 0;
+    for(k = 0; k < 8; k++)if(!(I[x] - I[x+off[k]] < 0))v += LBP_BIT[k];
+    L[x] = v;
+  }return;
+}
+//===========================================================================
+#ifdef NCC_AVX2
+__attribute__((target("avx2,fma"))) static void 
+GradAVX2(const float* I,int istep,float* G,int w)
+{
+  int x = 1;
+  for(; x+8 <= w-1; x += 8){
+    __m256 vx = _mm256_sub_ps(_mm256_loadu_ps(I+x+1),_mm256_loadu_ps(I+x-1));
+    __m256 vy = _mm256_sub_ps(_mm256_loadu_ps(I+x+istep),
+			      _mm256_loadu_ps(I+x-istep));
+    _mm256_storeu_ps(G+x,_mm256_fmadd_ps(vx,vx,_mm256_mul_ps(vy,vy)));
+  }
+  for(; x < w-1; x++){
+    float vx = I[x+1] - I[x-1],vy = I[x+istep] - I[x-istep];
+    G[x] = vx*vx + vy*vy;
+  }return;
+}
+//===========================================================================
+__attribute__((target("avx2,fma"))) static void 
+LBPAVX2(const float* I,int istep,float* L,int w)
+{
+  int k,off[8]; LBPOffsets(istep,off); int x = 1;
+  for(; x+8 <= w-1; x += 8){
+    __m256 c = _mm256_loadu_ps(I+x),v = _mm256_setzero_ps();
+    for(k = 0; k < 8; k++){
+      __m256 m = _mm256_cmp_ps(c,_mm256_loadu_ps(I+x+off[k]),_CMP_NLT_UQ);
+      v = _mm256_add_ps(v,_mm256_and_ps(m,_mm256_set1_ps(LBP_BIT[k])));
+    }
+    _mm256_storeu_ps(L+x,v);
+  }
+  for(; x < w-1; x++){
+    int v = 0;
+    for(k = 0; k < 8; k++)if(!(I[x] - I[x+off[k]] < 0))v += LBP_BIT[k];
+    L[x] = v;
+  }return;
+}
+#endif
+//===========================================================================
+#ifdef NCC_NEON
+static void 
+GradNEON(const float* I,int istep,float* G,int w)
+{
+  int x = 1;
+  for(; x+4 <= w-1; x += 4){
+    float32x4_t vx = vsubq_f32(vld1q_f32(I+x+1),vld1q_f32(I+x-1));
+    float32x4_t vy = vsubq_f32(vld1q_f32(I+x+istep),vld1q_f32(I+x-istep));
+    vst1q_f32(G+x,vmlaq_f32(vmulq_f32(vy,vy),vx,vx));
+  }
+  for(; x < w-1; x++){
+    float vx = I[x+1] - I[x-1],vy = I[x+istep] - I[x-istep];
+    G[x] = vx*vx + vy*vy;
+  }return;
+}
+//===========================================================================
+static void 
+LBPNEON(const float* I,int istep,float* L,int w)
+{
+  int k,off[8]; LBPOffsets(istep,off); int x = 1;
+  float32x4_t zero = vdupq_n_f32(0);
+  for(; x+4 <= w-1; x += 4){
+    float32x4_t c = vld1q_f32(I+x),v = zero;
+    for(k = 0; k < 8; k++){
+      uint32x4_t m = vcltq_f32(c,vld1q_f32(I+x+off[k]));
+      v = vaddq_f32(v,vbslq_f32(m,zero,vdupq_n_f32(LBP_BIT[k])));
+    }
+    vst1q_f32(L+x,v);
+  }
+  for(; x < w-1; x++){
+    int v = 0;
+    for(k = 0; k < 8; k++)if(!(I[x] - I[x+off[k]] < 0))v += LBP_BIT[k];
+    L[x] = v;
+  }return;
+}
+#endif
+//===========================================================================
+//zero the border of the output and run a row kernel over its interior
+static void 
+Feature(cv::Mat &im,cv::Mat &f,bool lbp)
+{
+  assert((im.rows == f.rows) && (im.cols == f.cols));
+  assert((im.type() == CV_32F) && (f.type() == CV_32F));
+  int y,h = im.rows,w = im.cols; if((h < 1) || (w < 1))return;
+  f.row(0) = cv::Scalar(0); f.row(h-1) = cv::Scalar(0);
+  if(h < 3 || w < 3){f = cv::Scalar(0); return;}
+  int kernel = kernel_,istep = im.step1();
+  for(y = 1; y < h-1; y++){
+    const float* I = im.ptr<float>(y); float* F = f.ptr<float>(y);
+    F[0] = 0; F[w-1] = 0;
+    switch(kernel){
+#ifdef NCC_AVX2
+    case KERNEL_AVX2: 
+      if(lbp)LBPAVX2(I,istep,F,w); else GradAVX2(I,istep,F,w); break;
+#endif
+#ifdef NCC_NEON
+    case KERNEL_NEON: 
+      if(lbp)LBPNEON(I,istep,F,w); else GradNEON(I,istep,F,w); break;
+#endif
+    default: 
+      if(lbp)LBPScalar(I,istep,F,w); else GradScalar(I,istep,F,w);
+    }
+  }return;
+}
+//===========================================================================
+void FACETRACKER::Grad(cv::Mat &im,cv::Mat &grad)
+{
+  Feature(im,grad,false); return;
+}
+//===========================================================================
+void FACETRACKER::LBP(cv::Mat &im,cv::Mat &lbp)
+{
+  Feature(im,lbp,true); return;
+}
+//===========================================================================
+template <typename T> static void 
+Logistic(cv::Mat &ncc,double a,double b,cv::Mat &resp)
+{
+  cv::MatIterator_<T> p = resp.begin<T>();
+  cv::MatIterator_<float> q1 = ncc.begin<float>();
+  cv::MatIterator_<float> q2 = ncc.end<float>();
+  while(q1 != q2)*p++ = 1.0/(1.0 + exp( *q1++ * a + b ));
+  return;
+}
+//===========================================================================
+void NCC::Response(cv::Mat &im,cv::Mat &T,double a,double b,
+		   cv::Mat &ncc,cv::Mat &resp)
+{
+  int h = im.rows - T.rows + 1, w = im.cols - T.cols + 1;
+  int type = (resp.type() == CV_32F) ? CV_32F : CV_64F;
+  if(resp.rows != h || resp.cols != w || resp.type() != type)
+    resp.create(h,w,type);
+  this->Correlate(im,T,ncc);
+  if(type == CV_32F)Logistic<float>(ncc,a,b,resp);
+  else              Logistic<double>(ncc,a,b,resp);
+  return;
+}
+//===========================================================================
+void NCC::Correlate(cv::Mat &im,cv::Mat &T,cv::Mat &ncc)
+{
+  assert((im.type() == CV_32F) && (T.type() == CV_32F));
+  assert((im.rows >= T.rows) && (im.cols >= T.cols));
+  int x,y,th = T.rows,tw = T.cols;
+  if(kernel_ == KERNEL_OPENCV){
+    int h = im.rows - th + 1, w = im.cols - tw + 1;
+    if(ncc.rows != h || ncc.cols != w || ncc.type() != CV_32F)
+      ncc.create(h,w,CV_32F);
+    cv::matchTemplate(im,T,ncc,CV_TM_CCOEFF_NORMED); return;
+  }
+  //zero mean template, so the correlation needs no window mean
+  if(tmem_.total() < size_t(th*tw))tmem_.create(1,th*tw,CV_32F);
+  cv::Mat tmpl(th,tw,CV_32F,tmem_.data);
+  double mean = 0,tnorm = 0,N = th*tw;
+  for(y = 0; y < th; y++){
+    const float* tp = T.ptr<float>(y);
+    for(x = 0; x < tw; x++)mean += tp[x];
+  }
+  mean /= N;
+  for(y = 0; y < th; y++){
+    const float* tp = T.ptr<float>(y); float* zp = tmpl.ptr<float>(y);
+    for(x = 0; x < tw; x++){
+      double v = tp[x] - mean; zp[x] = v; tnorm += v*v;
+    }
+  }
+  this->Correlate(im,tmpl,sqrt(tnorm),ncc); return;
+}
+//===========================================================================
+void NCC::Response(cv::Mat &im,cv::Mat &Tz,double tnorm,double a,double b,
+		   cv::Mat &ncc,cv::Mat &resp)
+{
+  int h = im.rows - Tz.rows + 1, w = im.cols - Tz.cols + 1;
+  int type = (resp.type() == CV_32F) ? CV_32F : CV_64F;
+  if(resp.rows != h || resp.cols != w || resp.type() != type)
+    resp.create(h,w,type);
+  this->Correlate(im,Tz,tnorm,ncc);
+  if(type == CV_32F)Logistic<float>(ncc,a,b,resp);
+  else              Logistic<double>(ncc,a,b,resp);
+  return;
+}
+//===========================================================================
+void NCC::Correlate(cv::Mat &im,cv::Mat &Tz,double tnorm,cv::Mat &ncc)
+{
+  assert((im.type() == CV_32F) && (Tz.type() == CV_32F) && Tz.isContinuous());
+  assert((im.rows >= Tz.rows) && (im.cols >= Tz.cols));
+  int x,y,th = Tz.rows,tw = Tz.cols,H = im.rows,W = im.cols;
+  int h = H - th + 1, w = W - tw + 1; double N = th*tw;
+  if(ncc.rows != h || ncc.cols != w || ncc.type() != CV_32F)
+    ncc.create(h,w,CV_32F);
+  assert(ncc.isContinuous());
+  int kernel = kernel_;
+  if(kernel == KERNEL_OPENCV)cv::matchTemplate(im,Tz,ncc,CV_TM_CCOEFF_NORMED);
+  else if(tnorm < DBL_EPSILON){ncc = cv::Scalar(1);}
+  else{
+    //window sums from integral images
+    if(sum_.rows < H+1 || sum_.cols < W+1){
+      int r = std::max(sum_.rows,H+1),c = std::max(sum_.cols,W+1);
+      sum_.create(r,c,CV_64F); sqsum_.create(r,c,CV_64F);
+    }
+    double* s0 = sum_.ptr<double>(0); double* q0 = sqsum_.ptr<double>(0);
+    for(x = 0; x <= W; x++){s0[x] = 0; q0[x] = 0;}
+    for(y = 0; y < H; y++){
+      const float* ip = im.ptr<float>(y); double rs = 0,rq = 0;
+      const double* s1 = sum_.ptr<double>(y); double* s2 = sum_.ptr<double>(y+1);
+      const double* q1 = sqsum_.ptr<double>(y); double* q2 =sqsum_.ptr<double>(y+1);
+      s2[0] = 0; q2[0] = 0;
+      for(x = 0; x < W; x++){
+	rs += ip[x]; rq += double(ip[x])*ip[x];
+	s2[x+1] = s1[x+1] + rs; q2[x+1] = q1[x+1] + rq;
+      }
+    }
+    const float* I = im.ptr<float>(0); int istep = im.step1();
+    float* R = ncc.ptr<float>(0); const float* T = Tz.ptr<float>(0);
+    switch(kernel){
+#ifdef NCC_AVX2
+    case KERNEL_AVX2: CorrAVX2(I,istep,T,tw,th,R,w,h); break;
+#endif
+#ifdef NCC_NEON
+    case KERNEL_NEON: CorrNEON(I,istep,T,tw,th,R,w,h); break;
+#endif
+    default: CorrScalar(I,istep,T,tw,th,R,w,h);
+    }
+    //normalise as cv::matchTemplate does
+    for(y = 0; y < h; y++){
+      const double* s1 = sum_.ptr<double>(y);
+      const double* s2 = sum_.ptr<double>(y+th);
+      const double* q1 = sqsum_.ptr<double>(y);
+      const double* q2 = sqsum_.ptr<double>(y+th);
+      float* rp = ncc.ptr<float>(y);
+      for(x = 0; x < w; x++){
+	double s = s2[x+tw] - s2[x] - s1[x+tw] + s1[x];
+	double q = q2[x+tw] - q2[x] - q1[x+tw] + q1[x];
+	double t = sqrt(std::max(q - s*s/N,0.0))*tnorm,v = rp[x];
+	if(fabs(v) < t)v /= t;
+	else if(fabs(v) < t*1.125)v = v > 0 ? 1 : -1;
+	else v = 0;
+	rp[x] = v;
+      }
+    }
+  }return;
+}
+//===========================================================================
+//bilinear sampling of windows about their centres, replicating the border
+//outside the image
+struct SampleBody : public ParallelBody{
+  cv::Mat &im,&pts; float* base; int* idx; int* pos; 
+  const WindowBatch::Offsets* offs;
+  SampleBody(cv::Mat &i,cv::Mat &p,float* b,int* ix,int* ps,
+	     const WindowBatch::Offsets* o)
+    : im(i),pts(p),base(b),idx(ix),pos(ps),offs(o){;}
+  void operator()(int begin,int end){
+    int W = im.cols,H = im.rows;
+    for(int k = begin; k < end; k++){
+      if(idx[k] < 0)continue;
+      const WindowBatch::Offsets &o = offs[idx[k]]; 
+      int w = o.size.width,h = o.size.height;
+      int step = (w + 7) & ~7; float* dst = base + pos[k];
+      double cx = pts.at<double>(0,k),cy = pts.at<double>(1,k);
+      bool inside = (cvFloor(cx + o.x0) >= 0) && (cvFloor(cx + o.x1) < W-1) &&
+	(cvFloor(cy + o.y0) >= 0) && (cvFloor(cy + o.y1) < H-1);
+      for(int v = 0; v < h; v++){
+	const double* px = o.x.ptr<double>(v); 
+	const double* py = o.y.ptr<double>(v);
+	float* dp = dst + v*step;
+	if(inside){
+	  for(int u = 0; u < w; u++){
+	    double xs = cx + px[u],ys = cy + py[u];
+	    int ix = cvFloor(xs),iy = cvFloor(ys);
+	    float a = xs - ix,b = ys - iy;
+	    const uchar* p0 = im.ptr<uchar>(iy) + ix; 
+	    const uchar* p1 = p0 + im.step;
+	    dp[u] = (p0[0] + a*(p0[1] - p0[0]))*(1.f - b) + 
+	      (p1[0] + a*(p1[1] - p1[0]))*b;
+	  }
+	}else{
+	  for(int u = 0; u < w; u++){
+	    double xs = cx + px[u],ys = cy + py[u];
+	    int ix = cvFloor(xs),iy = cvFloor(ys);
+	    float a = xs - ix,b = ys - iy;
+	    int x0 = std::min(std::max(ix,0),W-1),x1 = std::min(std::max(ix+1,0),W-1);
+	    int y0 = std::min(std::max(iy,0),H-1),y1 = std::min(std::max(iy+1,0),H-1);
+	    const uchar* p0 = im.ptr<uchar>(y0); const uchar* p1 = im.ptr<uchar>(y1);
+	    dp[u] = (p0[x0] + a*(p0[x1] - p0[x0]))*(1.f - b) + 
+	      (p1[x0] + a*(p1[x1] - p1[x0]))*b;
+	  }
+	}
+      }
+    }return;
+  }
+};
+//===========================================================================
+void WindowBatch::Extract(cv::Mat &im,double a11,double a12,double a21,
+			  double a22,cv::Mat &pts,vector<cv::Size> &size)
+{
+  assert((im.type() == CV_8U) && (pts.type() == CV_64F));
+  assert((pts.rows == 2) && (pts.cols == int(size.size())));
+  int i,j,x,y,n = size.size(),total = 0; 
+  size_ = size; idx_.resize(n); pos_.resize(n);
+
+  //sampling offsets of each window size, centred as cvGetQuadrangleSubPix
+  int nsize = 0;
+  for(i = 0; i < n; i++){
+    idx_[i] = -1; if((size[i].width <= 0) || (size[i].height <= 0))continue;
+    for(j = 0; j < nsize; j++)if(offs_[j].size == size[i])break;
+    if(j == nsize){
+      if(int(offs_.size()) <= nsize)offs_.resize(nsize+1);
+      Offsets &o = offs_[nsize++]; int w = size[i].width,h = size[i].height;
+      o.size = size[i]; o.x.create(h,w,CV_64F); o.y.create(h,w,CV_64F);
+      double cx = (w-1)*0.5,cy = (h-1)*0.5;
+      o.x0 = o.y0 = DBL_MAX; o.x1 = o.y1 = -DBL_MAX;
+      for(y = 0; y < h; y++){
+	double* px = o.x.ptr<double>(y); double* py = o.y.ptr<double>(y);
+	for(x = 0; x < w; x++){
+	  px[x] = a11*(x-cx) + a12*(y-cy); py[x] = a21*(x-cx) + a22*(y-cy);
+	  o.x0 = std::min(o.x0,px[x]); o.x1 = std::max(o.x1,px[x]);
+	  o.y0 = std::min(o.y0,py[x]); o.y1 = std::max(o.y1,py[x]);
+	}
+      }
+    }
+    idx_[i] = j; pos_[i] = total; 
+    total += size[i].height*((size[i].width + 7) & ~7);
+  }
+  if(buf_.total() < size_t(total + 8))buf_.create(1,total + 8,CV_32F);
+  base_ = (float*)(((size_t)buf_.data + 31) & ~size_t(31));
+  if(nsize == 0)return;
+  SampleBody body(im,pts,base_,&idx_[0],&pos_[0],&offs_[0]);
+  ParallelFor(0,n,body); return;
+}
+//===========================================================================
+cv::Mat WindowBatch::Window(int i)
+{
+  assert((i >= 0) && (i < int(idx_.size())) && (idx_[i] >= 0));
+  int w = size_[i].width,h = size_[i].height,step = (w + 7) & ~7;
+  return cv::Mat(h,w,CV_32F,base_ + pos_[i],step*sizeof(float));
+}
+//===========================================================================
@@ -0,0 +1,100 @@
+// CSIRO has filed various patents which cover the Software. 
+
+// CSIRO grants to you a license to any patents granted for inventions
+// implemented by the Software for academic, research and non-commercial
+// use only.
+
+// CSIRO hereby reserves all rights to its inventions implemented by the
+// Software and any patents subsequently granted for those inventions
+// that are not expressly granted to you.  Should you wish to license the
+// patents relating to the Software for commercial use please contact
+// CSIRO IP & Licensing, Gautam Tendulkar (gautam.tendulkar@csiro.au) or
+// Nick Marsh (nick.marsh@csiro.au)
+
+// This software is provided under the CSIRO OPEN SOURCE LICENSE
+// (GPL2) which can be found in the LICENSE file located in the top
+// most directory of the source code.
+
+// Copyright CSIRO 2013
+
+#ifndef _TRACKER_PatchKernels_h_
+#define _TRACKER_PatchKernels_h_
+#include <tracker/IO.hpp>
+namespace FACETRACKER
+{
+  //===========================================================================
+  /** 
+      Kernels used to evaluate patch experts. The fastest kernel supported 
+      by the CPU is selected when the library is loaded. KERNEL_OPENCV is 
+      the original cv::matchTemplate implementation, kept for reference.
+  */
+  enum{KERNEL_OPENCV = 0,KERNEL_SCALAR,KERNEL_AVX2,KERNEL_NEON};
+  int  PatchKernel();               //kernel currently in use
+  bool SetPatchKernel(int kernel);  //false if not supported by this CPU
+  //===========================================================================
+  /**
+     Feature channels of the patch experts, computed with the kernel in
+     use. The output is CV_32F, the size of im, with a zero border.
+  */
+  void Grad(cv::Mat &im,cv::Mat &grad); //squared gradient magnitude
+  void LBP(cv::Mat &im,cv::Mat &lbp);   //local binary pattern code
+  //===========================================================================
+  /**
+     Normalised cross-correlation (CV_TM_CCOEFF_NORMED) of a patch template
+     with an image window, followed by the logistic mapping of the patch.
+  */
+  class NCC{
+  public:
+    void 
+    Response(cv::Mat &im,   //image window (CV_32F)
+	     cv::Mat &T,    //template (CV_32F)
+	     double a,      //logistic gain
+	     double b,      //logistic bias
+	     cv::Mat &ncc,  //correlation (CV_32F) on return
+	     cv::Mat &resp);//logistic response on return, CV_32F if resp 
+                            //is CV_32F on entry and CV_64F otherwise
+    void
+    Correlate(cv::Mat &im,  //image window (CV_32F)
+	      cv::Mat &T,   //template (CV_32F)
+	      cv::Mat &ncc);//continuous correlation (CV_32F) on return
+    void                    //as above with a precomputed template
+    Response(cv::Mat &im,cv::Mat &Tz,double tnorm,double a,double b,
+	     cv::Mat &ncc,cv::Mat &resp);
+    void
+    Correlate(cv::Mat &im,  //image window (CV_32F)
+	      cv::Mat &Tz,  //zero mean template (CV_32F, continuous)
+	      double tnorm, //its norm
+	      cv::Mat &ncc);//as above
+  private:
+    cv::Mat tmem_,sum_,sqsum_; //grown to the largest window seen
+  };
+  //===========================================================================
+  /**
+     Windows sampled about a set of points with a shared rotation and 
+     scale, each as cvGetQuadrangleSubPix would sample it, extracted in one
+     pass into a single buffer. The sampling offsets of each window size 
+     are computed once per call, and every window starts on a 32 byte 
+     boundary with its rows padded to a multiple of 8 floats.
+  */
+  class WindowBatch{
+  public:
+    WindowBatch(){base_ = NULL;}
+    void 
+    Extract(cv::Mat &im,                  //grayscale image (CV_8U)
+	    double a11,double a12,        //linear part of the sampling 
+	    double a21,double a22,        //transform, shared by all windows
+	    cv::Mat &pts,                 //2 x n centres (CV_64F) 
+	    std::vector<cv::Size> &size); //window sizes, empty ones skipped
+    cv::Mat Window(int i);              //window i (CV_32F) of last Extract
+
+    struct Offsets{
+      cv::Size size; cv::Mat x,y; //sampling offsets from the centre
+      double x0,x1,y0,y1;         //their range
+    };
+  private:
+    std::vector<Offsets> offs_; cv::Mat buf_; float* base_;
+    std::vector<int> idx_,pos_; std::vector<cv::Size> size_;
+  };
+  //===========================================================================
+}
+#endif
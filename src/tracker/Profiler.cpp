@@ -0,0 +1,103 @@
+// CSIRO has filed various patents which cover the Software. 
+
+// CSIRO grants to you a license to any patents granted for inventions
+// implemented by the Software for academic, research and non-commercial
+// use only.
+
+// CSIRO hereby reserves all rights to its inventions implemented by the
+// Software and any patents subsequently granted for those inventions
+// that are not expressly granted to you.  Should you wish to license the
+// patents relating to the Software for commercial use please contact
+// CSIRO IP & Licensing, Gautam Tendulkar (gautam.tendulkar@csiro.au) or
+// Nick Marsh (nick.marsh@csiro.au)
+
+// This software is provided under the CSIRO OPEN SOURCE LICENSE
+// (GPL2) which can be found in the LICENSE file located in the top
+// most directory of the source code.
+
+// Copyright CSIRO 2013
+
+#include <tracker/Profiler.hpp>
+#include <algorithm>
+using namespace FACETRACKER;
+using namespace std;
+//===========================================================================
+void Profiler::Reset()
+{
+  for(int i = 0; i < NSTAGES; i++)frame_[i] = 0;
+  for(int i = 0; i < NCOUNTERS; i++)count_[i] = 0;
+  n_ = 0; pos_ = 0; hist_.release(); return;
+}
+//===========================================================================
+void Profiler::EndFrame()
+{
+  if(!_enabled)return;
+  if(hist_.rows != HISTORY)hist_.create(HISTORY,NSTAGES+NCOUNTERS,CV_64F);
+  double s = 1000.0/cv::getTickFrequency(); double* h = hist_.ptr<double>(pos_);
+  for(int i = 0; i < NSTAGES; i++)h[i] = s*frame_[i];
+  for(int i = 0; i < NCOUNTERS; i++)h[NSTAGES+i] = count_[i];
+  pos_ = (pos_+1) % HISTORY; n_ = min(n_+1,int(HISTORY)); return;
+}
+//===========================================================================
+double Profiler::Last(int stage)
+{
+  if(n_ == 0)return 0.0;
+  return hist_.at<double>((pos_+HISTORY-1) % HISTORY,stage);
+}
+//===========================================================================
+double Profiler::Percentile(int stage,double p)
+{
+  if(n_ == 0)return 0.0;
+  if(sort_.rows != HISTORY)sort_.create(HISTORY,1,CV_64F);
+  double* v = sort_.ptr<double>(0);
+  for(int i = 0; i < n_; i++)v[i] = hist_.at<double>(i,stage);
+  int k = min(n_-1,max(0,int(p/100.0*n_)));
+  nth_element(v,v+k,v+n_); return v[k];
+}
+//===========================================================================
+double Profiler::LastCount(int counter)
+{
+  return this->Last(NSTAGES+counter);
+}
+//===========================================================================
+double Profiler::MeanCount(int counter)
+{
+  if(n_ == 0)return 0.0;
+  double sum = 0.0;
+  for(int i = 0; i < n_; i++)sum += hist_.at<double>(i,NSTAGES+counter);
+  return sum/n_;
+}
+//===========================================================================
+void Profiler::Print(ostream &s)
+{
+  char str[256];
+  sprintf(str,"%-12s %9s %9s %9s %9s\n","stage (ms)","last","p50","p95","p99");
+  s << str;
+  for(int i = 0; i < NSTAGES; i++){
+    sprintf(str,"%-12s %9.3f %9.3f %9.3f %9.3f\n",Name(i),this->Last(i),
+	    this->Percentile(i,50),this->Percentile(i,95),
+	    this->Percentile(i,99));
+    s << str;
+  }
+  for(int i = 0; i < NCOUNTERS; i++){
+    sprintf(str,"%-12s %9.1f per frame\n",CounterName(i),this->MeanCount(i));
+    s << str;
+  }
+  s << n_ << " frames" << endl; return;
+}
+//===========================================================================
+const char* Profiler::Name(int stage)
+{
+  static const char* names[NSTAGES] = {"detect","redetect","response",
+				       "rigid","nonrigid","predict","check",
+				       "update","atm","calcparams","flow",
+				       "frame"};
+  assert((stage >= 0) && (stage < NSTAGES)); return names[stage];
+}
+//===========================================================================
+const char* Profiler::CounterName(int counter)
+{
+  static const char* names[NCOUNTERS] = {"iterations","unused"};
+  assert((counter >= 0) && (counter < NCOUNTERS)); return names[counter];
+}
+//===========================================================================
@@ -0,0 +1,104 @@
+// CSIRO has filed various patents which cover the Software. 
+
+// CSIRO grants to you a license to any patents granted for inventions
+// implemented by the Software for academic, research and non-commercial
+// use only.
+
+// CSIRO hereby reserves all rights to its inventions implemented by the
+// Software and any patents subsequently granted for those inventions
+// that are not expressly granted to you.  Should you wish to license the
+// patents relating to the Software for commercial use please contact
+// CSIRO IP & Licensing, Gautam Tendulkar (gautam.tendulkar@csiro.au) or
+// Nick Marsh (nick.marsh@csiro.au)
+
+// This software is provided under the CSIRO OPEN SOURCE LICENSE
+// (GPL2) which can be found in the LICENSE file located in the top
+// most directory of the source code.
+
+// Copyright CSIRO 2013
+
+#ifndef _TRACKER_Profiler_h_
+#define _TRACKER_Profiler_h_
+#include <tracker/Config.h>
+#include <tracker/IO.hpp>
+#include <iostream>
+namespace FACETRACKER
+{
+  //===========================================================================
+  /**
+     Per-stage timing of the face tracker. Times are accumulated per frame
+     while the profiler is enabled, and the last HISTORY frames are kept for
+     percentile queries. Counters such as the number of fitting iterations
+     are kept per frame alongside the times. Unless built with
+     WITH_PROFILER, profiling is compiled out and all queries return
+     zero.
+  */
+  class Profiler{
+  public:
+    enum{DETECT = 0,REDETECT,RESPONSE,RIGID,NONRIGID,PREDICT,CHECK,UPDATE,
+	 ATM,CALCPARAMS,FLOW,FRAME,NSTAGES};
+    enum{ITERATIONS = 0, //fitting iterations run
+	 UNUSED,         //of the itol budget, left by early convergence
+	 NCOUNTERS};
+    enum{HISTORY = 512};
+    bool _enabled; /**< Record timings? */
+
+    Profiler(){_enabled = false; this->Reset();}
+    void Enable(bool enable = true){_enabled = enable;}
+    void Reset();                    //forget all recorded frames
+    inline void 
+    BeginFrame(){
+      if(_enabled){
+	for(int i = 0; i < NSTAGES; i++)frame_[i] = 0;
+	for(int i = 0; i < NCOUNTERS; i++)count_[i] = 0;
+      }
+    }
+    void EndFrame();                 //record the current frame
+    inline void 
+    Add(int stage,int64 ticks){frame_[stage] += ticks;}
+    inline void 
+    Count(int counter,int n){if(_enabled)count_[counter] += n;}
+    
+    int nFrames(){return n_;}        //frames in the history
+    double Last(int stage);          //milliseconds in the last frame
+    double Percentile(int stage,     //milliseconds over the history
+		      double p);     //percentile (0-100)
+    double LastCount(int counter);   //count in the last frame
+    double MeanCount(int counter);   //mean count per frame over the history
+    void Print(std::ostream &s);     //p50/p95/p99 of every stage
+    static const char* Name(int stage);
+    static const char* CounterName(int counter);
+  private:
+    int64 frame_[NSTAGES]; int count_[NCOUNTERS]; 
+    int n_,pos_; cv::Mat hist_,sort_;
+  };
+  //===========================================================================
+  /**
+     Adds the time until the end of the enclosing scope to a stage of a
+     profiler. Use through the PROFILE_STAGE macro.
+  */
+  class ProfileScope{
+  public:
+    ProfileScope(Profiler* p,int stage){
+      p_ = ((p != NULL) && p->_enabled) ? p : NULL; 
+      if(p_){stage_ = stage; t_ = cv::getTickCount();}
+    }
+    ~ProfileScope(){if(p_)p_->Add(stage_,cv::getTickCount()-t_);}
+  private:
+    Profiler* p_; int stage_; int64 t_;
+  };
+  //===========================================================================
+}
+#define PROFILE_CONCAT_(a,b) a##b
+#define PROFILE_CONCAT(a,b) PROFILE_CONCAT_(a,b)
+#ifdef WITH_PROFILER
+#define PROFILE_STAGE(profiler,stage)					\
+  FACETRACKER::ProfileScope PROFILE_CONCAT(profile_,__LINE__)(profiler,	\
+    FACETRACKER::Profiler::stage)
+#define PROFILE_COUNT(profiler,counter,n)				\
+  do{if(profiler)(profiler)->Count(FACETRACKER::Profiler::counter,n);}while(0)
+#else
+#define PROFILE_STAGE(profiler,stage)
+#define PROFILE_COUNT(profiler,counter,n)
+#endif
+#endif
@@ -45,13 +45,13 @@ RegistrationCheck::Read(ifstream &s,
 {
   int type; 
   if(readType){s >> type; assert(type == IO::REGOCHECK);}
-  s >> _a >> _b >> _c; IO::ReadMat(s,_w);
+  s >> _a >> _b >> _c; IO::ReadMat(s,_w); w32_.release();
  
   _paw.Read(s); return;
 }
 //===========================================================================
 void 
-RegistrationCheck::ReadBinary(ifstream &s,
+RegistrationCheck::ReadBinary(istream &s,
 			      bool readType)
 {
  
@@ -64,7 +64,7 @@ RegistrationCheck::ReadBinary(ifstream &s,
     s.read(reinterpret_cast<char*>(&_a), sizeof(_a));
     s.read(reinterpret_cast<char*>(&_b), sizeof(_b));
     s.read(reinterpret_cast<char*>(&_c), sizeof(_c));
-    IOBinary::ReadMat(s, _w);
+    IOBinary::ReadMat(s, _w); w32_.release();
 
   
   _paw.ReadBinary(s); return;
@@ -77,8 +77,9 @@ RegistrationCheck::Check(cv::Mat &im,
   if((s.rows != _paw._src.rows) || (s.cols != 1) || (s.type() != CV_64F))
     return -1;
   _paw.Crop(im,crop_,s); _paw.VectorizeUchar(crop_,vec_);
-  cv::equalizeHist(vec_,vec_); vec_.convertTo(x_,CV_64F);
-  cv::normalize(x_,x_); double val = _w.dot(x_) + _b;
+  cv::Mat &w = w32_.empty() ? _w : w32_;
+  cv::equalizeHist(vec_,vec_); vec_.convertTo(x_,w.type());
+  cv::normalize(x_,x_); double val = w.dot(x_) + _b;
   double prob = 1.0/(1.0 + exp( val * _a + _c )); return int(prob*10 + 0.5);
 }
 //===========================================================================
@@ -109,7 +110,7 @@ mvRegistrationCheck::Read(ifstream &s,
 }
 //===========================================================================
 void 
-mvRegistrationCheck::ReadBinary(ifstream &s,
+mvRegistrationCheck::ReadBinary(istream &s,
 			  bool readType)
 {
   if(readType){int type; 
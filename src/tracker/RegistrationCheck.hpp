@@ -46,7 +46,18 @@ namespace FACETRACKER
     }
     RegistrationCheck& operator=(RegistrationCheck const&rhs){
       this->_a = rhs._a; this->_b = rhs._b; this->_c = rhs._c;
-      this->_w = rhs._w.clone(); this->_paw = rhs._paw; return *this;
+      this->_w = rhs._w.clone(); this->_paw = rhs._paw; 
+      this->w32_ = rhs.w32_.clone(); return *this;
+    }
+    void
+    Share(RegistrationCheck const&rhs){ //share model, own scratch memory
+      _a = rhs._a; _b = rhs._b; _c = rhs._c; _w = rhs._w; _paw.Share(rhs._paw);
+      w32_ = rhs.w32_; crop_.release(); vec_.release(); x_.release();
+    }
+    void
+    SetPrecision(int type){ //CV_32F keeps a float copy of _w
+      if(type == CV_32F){if(w32_.empty())_w.convertTo(w32_,CV_32F);}
+      else w32_.release();
     }
     void 
     Init(double a,   //probability gain
@@ -54,7 +65,7 @@ namespace FACETRACKER
 	 double c,   //probability bias
 	 cv::Mat &w, //svm gain
 	 PAW &paw){  //warping function
-      _a = a; _b = b; _c = c; _paw = paw; _w = w.clone();
+      _a = a; _b = b; _c = c; _paw = paw; _w = w.clone(); w32_.release();
     }
     void 
     Load(const char* fname, bool binary = false){
@@ -72,11 +83,12 @@ namespace FACETRACKER
     }
     void Write(std::ofstream &s, bool binary = false);
     void Read(std::ifstream &s,bool readType = true);
-    void ReadBinary(std::ifstream &s,bool readType = true);
+    void ReadBinary(std::istream &s,bool readType = true);
     int                //-1 on failure, [0:10] health otherwise
     Check(cv::Mat &im, //image
 	  cv::Mat &s); //shape
   private:
+    cv::Mat w32_; //float gain used when non-empty
     cv::Mat crop_,vec_,x_;
   };
   //===========================================================================
@@ -93,7 +105,14 @@ namespace FACETRACKER
     mvRegistrationCheck& operator=(mvRegistrationCheck const&rhs){      
       this->_rego = rhs._rego; return *this;
     }
+    void Share(mvRegistrationCheck const&rhs){
+      _rego.resize(rhs._rego.size());
+      for(size_t i = 0; i < rhs._rego.size(); i++)_rego[i].Share(rhs._rego[i]);
+    }
     void Init(std::vector<RegistrationCheck> &rego){_rego = rego;}
+    void SetPrecision(int type){
+      for(size_t i = 0; i < _rego.size(); i++)_rego[i].SetPrecision(type);
+    }
 
     void 
     Load(const char* fname, bool binary = false){
@@ -110,7 +129,7 @@ namespace FACETRACKER
     }
     void Write(std::ofstream &s, bool binary = false);
     void Read(std::ifstream &s,bool readType = true);
-    void ReadBinary(std::ifstream &s,bool readType = true);
+    void ReadBinary(std::istream &s,bool readType = true);
     int                //-1 on failure, [0:10] health otherwise
     Check(cv::Mat &im, //image
 	  cv::Mat &s,  //shape
@@ -43,12 +43,210 @@ void FACETRACKER::AddOrthRow(cv::Mat &R)
   return;
 }
 //=============================================================================
+//C = A*B for small matrices, C must not share data with A or B
+static void MulSmall(cv::Mat &A,cv::Mat &B,cv::Mat &C)
+{
+  assert((A.cols == B.rows) && (C.rows == A.rows) && (C.cols == B.cols));
+  for(int i = 0; i < C.rows; i++){
+    for(int j = 0; j < C.cols; j++){
+      double v = 0.0; 
+      for(int k = 0; k < A.cols; k++)v += A.db(i,k)*B.db(k,j);
+      C.db(i,j) = v;
+    }
+  }return;
+}
+//=============================================================================
+//The kernels below are templated on the number of points and modes so
+//the loops over the face model shipped in resources/face.pdm3d have
+//compile time bounds. A size of 0 means the bound is read at run time,
+//which is the fallback for any other model.
+enum{NPTS = 66,NMODES = 24};
+//=============================================================================
+//s = M + V*p, with V of type T and R rows by C modes
+template <typename T,int R,int C> static void 
+LinearShapeN(cv::Mat &M,cv::Mat &V,cv::Mat &p,cv::Mat &s)
+{
+  const int rows = R ? R : M.rows,m = C ? C : V.cols;
+  const double* pp = p.ptr<double>(0);
+  for(int i = 0; i < rows; i++){
+    const T* v = V.ptr<T>(i); T x = 0;
+    for(int j = 0; j < m; j++)x += v[j]*static_cast<T>(pp[j]);
+    s.db(i,0) = M.db(i,0) + x;
+  }return;
+}
+template <typename T> static void 
+LinearShape(cv::Mat &M,cv::Mat &V,cv::Mat &p,cv::Mat &s)
+{
+  if((V.rows == 3*NPTS) && (V.cols == NMODES))
+    LinearShapeN<T,3*NPTS,NMODES>(M,V,p,s);
+  else LinearShapeN<T,0,0>(M,V,p,s);
+}
+//=============================================================================
+//p = V'*(S-M), with V of type T and R rows by C modes
+template <typename T,int R,int C> static void 
+LinearParamsN(cv::Mat &M,cv::Mat &V,cv::Mat &S,cv::Mat &p)
+{
+  const int rows = R ? R : M.rows,m = C ? C : V.cols;
+  double* pp = p.ptr<double>(0);
+  for(int j = 0; j < m; j++)pp[j] = 0.0;
+  for(int i = 0; i < rows; i++){
+    const T* v = V.ptr<T>(i); double e = S.db(i,0) - M.db(i,0);
+    for(int j = 0; j < m; j++)pp[j] += v[j]*e;
+  }return;
+}
+template <typename T> static void 
+LinearParams(cv::Mat &M,cv::Mat &V,cv::Mat &S,cv::Mat &p)
+{
+  if((V.rows == 3*NPTS) && (V.cols == NMODES))
+    LinearParamsN<T,3*NPTS,NMODES>(M,V,S,p);
+  else LinearParamsN<T,0,0>(M,V,S,p);
+}
+//=============================================================================
+//mode columns of the projected Jacobian rows of point i (of n), P is 2x3
+template <typename T,int C> static void 
+ModeJacobN(const double* P,cv::Mat &V,int i,int n,double* Jx,double* Jy)
+{
+  const int m = C ? C : V.cols;
+  const T* vx = V.ptr<T>(i); const T* vy = V.ptr<T>(i+n);
+  const T* vz = V.ptr<T>(i+n*2);
+  T p0 = P[0],p1 = P[1],p2 = P[2],p3 = P[3],p4 = P[4],p5 = P[5];
+  for(int j = 0; j < m; j++){
+    Jx[j] = p0*vx[j] + p1*vy[j] + p2*vz[j];
+    Jy[j] = p3*vx[j] + p4*vy[j] + p5*vz[j];
+  }return;
+}
+template <typename T> static void 
+ModeJacob(const double* P,cv::Mat &V,int i,int n,double* Jx,double* Jy)
+{
+  if(V.cols == NMODES)ModeJacobN<T,NMODES>(P,V,i,n,Jx,Jy);
+  else ModeJacobN<T,0>(P,V,i,n,Jx,Jy);
+}
+//=============================================================================
 void FACETRACKER::MetricUpgrade(cv::Mat &R)
 {
   assert((R.rows == 3) && (R.cols == 3));
-  cv::SVD svd(R,cv::SVD::MODIFY_A);
-  cv::Mat X = svd.u*svd.vt,W = cv::Mat::eye(3,3,CV_64F); 
-  W.db(2,2) = determinant(X); R = svd.u*W*svd.vt; return;
+  double w[3],u[9],vt[9],x[9];
+  cv::Mat W(3,1,CV_64F,w),U(3,3,CV_64F,u),Vt(3,3,CV_64F,vt),X(3,3,CV_64F,x);
+  cv::SVD::compute(R,W,U,Vt); MulSmall(U,Vt,X); double d = cv::determinant(X);
+  for(int i = 0; i < 3; i++){
+    for(int j = 0; j < 3; j++)
+      R.db(i,j) = u[i*3]*vt[j] + u[i*3+1]*vt[3+j] + d*u[i*3+2]*vt[6+j];
+  }return;
+}
+//=============================================================================
+//H += w*J'*J for R rows and C columns of J
+template <int R,int C> static void 
+AddJtJN(cv::Mat &J,double w,cv::Mat &H)
+{
+  const int rows = R ? R : J.rows,p = C ? C : J.cols;
+  for(int k = 0; k < rows; k++){ //upper triangle, one row of J at a time
+    const double* j = J.ptr<double>(k);
+    for(int a = 0; a < p; a++){
+      if(j[a] == 0.0)continue;
+      double v = w*j[a],*h = H.ptr<double>(a);
+      for(int b = a; b < p; b++)h[b] += v*j[b];
+    }
+  }
+  for(int a = 1; a < p; a++){
+    double* h = H.ptr<double>(a); for(int b = 0; b < a; b++)h[b] = H.db(b,a);
+  }return;
+}
+void FACETRACKER::AddJtJ(cv::Mat &J,double w,cv::Mat &H)
+{
+  assert((J.type() == CV_64F) && (H.type() == CV_64F) && 
+	 (H.rows == J.cols) && (H.cols == J.cols));
+  if(J.rows == 2*NPTS){
+    if     (J.cols == 6+NMODES){AddJtJN<2*NPTS,6+NMODES>(J,w,H); return;}
+    else if(J.cols == 6       ){AddJtJN<2*NPTS,6       >(J,w,H); return;}
+  }
+  AddJtJN<0,0>(J,w,H); return;
+}
+//=============================================================================
+//g += w*J'*r for R rows and C columns of J
+template <int R,int C> static void 
+AddJtrN(cv::Mat &J,cv::Mat &r,double w,cv::Mat &g)
+{
+  const int rows = R ? R : J.rows,p = C ? C : J.cols;
+  double* pg = g.ptr<double>(0);
+  for(int k = 0; k < rows; k++){
+    const double* j = J.ptr<double>(k); double v = w*r.db(k,0);
+    if(v == 0.0)continue;
+    for(int a = 0; a < p; a++)pg[a] += v*j[a];
+  }return;
+}
+void FACETRACKER::AddJtr(cv::Mat &J,cv::Mat &r,double w,cv::Mat &g)
+{
+  assert((J.type() == CV_64F) && (r.type() == CV_64F) && (g.type() == CV_64F));
+  assert((r.rows == J.rows) && (r.cols == 1) && 
+	 (g.rows == J.cols) && (g.cols == 1) && g.isContinuous());
+  if(J.rows == 2*NPTS){
+    if     (J.cols == 6+NMODES){AddJtrN<2*NPTS,6+NMODES>(J,r,w,g); return;}
+    else if(J.cols == 6       ){AddJtrN<2*NPTS,6       >(J,r,w,g); return;}
+  }
+  AddJtrN<0,0>(J,r,w,g); return;
+}
+//=============================================================================
+//H(6+i,6+i) += w/E(i) and g(6+i) -= w*p(i)/E(i) for C modes
+template <int C> static void 
+AddShapePriorN(cv::Mat &E,cv::Mat &p,double w,cv::Mat &H,cv::Mat &g)
+{
+  const int m = C ? C : E.cols;
+  const double* e = E.ptr<double>(0); const double* pp = p.ptr<double>(0);
+  double* pg = g.ptr<double>(0);
+  for(int i = 0; i < m; i++){
+    double v = w/e[i]; H.db(6+i,6+i) += v; pg[6+i] -= v*pp[i];
+  }return;
+}
+void FACETRACKER::AddShapePrior(cv::Mat &E,cv::Mat &p,double w,
+				cv::Mat &H,cv::Mat &g)
+{
+  assert((E.type() == CV_64F) && (p.type() == CV_64F) &&
+	 (H.type() == CV_64F) && (g.type() == CV_64F));
+  assert((E.rows == 1) && (p.rows == E.cols) && (p.cols == 1) &&
+	 (H.rows == 6+E.cols) && (H.cols == 6+E.cols) && (g.rows == H.rows) &&
+	 p.isContinuous() && g.isContinuous());
+  if(E.cols == NMODES)AddShapePriorN<NMODES>(E,p,w,H,g);
+  else AddShapePriorN<0>(E,p,w,H,g);
+  return;
+}
+//=============================================================================
+//H*x = g for an N by N system, L overwrites the lower triangle of H
+template <int N> static bool 
+CholSolveN(cv::Mat &H,cv::Mat &g,cv::Mat &x)
+{
+  const int n = N ? N : H.rows; double v;
+  const double* pg = g.ptr<double>(0); double* px = x.ptr<double>(0);
+  for(int j = 0; j < n; j++){ //H = L*L'
+    double* hj = H.ptr<double>(j); v = hj[j];
+    for(int k = 0; k < j; k++)v -= hj[k]*hj[k];
+    if(v <= 0.0){x = cv::Scalar(0); return false;}
+    hj[j] = v = sqrt(v);
+    for(int i = j+1; i < n; i++){
+      double* hi = H.ptr<double>(i),d = hi[j];
+      for(int k = 0; k < j; k++)d -= hi[k]*hj[k];
+      hi[j] = d/v;
+    }
+  }
+  for(int i = 0; i < n; i++){ //L*y = g
+    const double* hi = H.ptr<double>(i); v = pg[i];
+    for(int k = 0; k < i; k++)v -= hi[k]*px[k];
+    px[i] = v/hi[i];
+  }
+  for(int i = n-1; i >= 0; i--){ //L'*x = y
+    v = px[i];
+    for(int k = i+1; k < n; k++)v -= H.db(k,i)*px[k];
+    px[i] = v/H.db(i,i);
+  }return true;
+}
+bool FACETRACKER::CholSolve(cv::Mat &H,cv::Mat &g,cv::Mat &x)
+{
+  assert((H.type() == CV_64F) && (g.type() == CV_64F) && (x.type() == CV_64F));
+  assert((H.cols == H.rows) && (g.rows == H.rows) && (g.cols == 1) && 
+	 (x.rows == H.rows) && (x.cols == 1) && 
+	 g.isContinuous() && x.isContinuous());
+  if     (H.rows == 6+NMODES)return CholSolveN<6+NMODES>(H,g,x);
+  else if(H.rows == 6       )return CholSolveN<6       >(H,g,x);
+  else                       return CholSolveN<0       >(H,g,x);
 }
 //===========================================================================
 void FACETRACKER::Euler2Rot(cv::Mat &R,const double pitch,const double yaw,
@@ -97,19 +295,54 @@ void FACETRACKER::Align3Dto2DShapes(double& scale,double& pitch,double& yaw,
 				    cv::Mat &s2D,cv::Mat &s3D)
 {
   assert((s2D.cols == 1) && (s3D.rows == 3*(s2D.rows/2)) && (s3D.cols == 1));
-  int i,n = s2D.rows/2; double t2[2],t3[3];
-  cv::Mat s2D_cpy = s2D.clone(),s3D_cpy = s3D.clone();
-  cv::Mat X = (s2D_cpy.reshape(1,2)).t(),S = (s3D_cpy.reshape(1,3)).t();
-  for(i = 0; i < 2; i++){cv::Mat v = X.col(i); t2[i] = sum(v)[0]/n; v-=t2[i];}
-  for(i = 0; i < 3; i++){cv::Mat v = S.col(i); t3[i] = sum(v)[0]/n; v-=t3[i];}
-	cv::Mat M = ((S.t()*S).inv(cv::DECOMP_CHOLESKY))*S.t()*X;
-  cv::Mat MtM = M.t()*M; cv::SVD svd(MtM,cv::SVD::MODIFY_A);
-  svd.w.db(0,0) = 1.0/sqrt(svd.w.db(0,0));
-  svd.w.db(1,0) = 1.0/sqrt(svd.w.db(1,0));
-  cv::Mat T(3,3,CV_64F);
-  T(cv::Rect(0,0,3,2)) = svd.u*cv::Mat::diag(svd.w)*svd.vt*M.t();
-  scale = 0.5*sum(T(cv::Rect(0,0,3,2)).mul(M.t()))[0];
-  AddOrthRow(T); Rot2Euler(T,pitch,yaw,roll); T *= scale;
+  int i,j,k,n = s2D.rows/2; double t2[2] = {0,0},t3[3] = {0,0,0};
+  double A[3][3] = {{0,0,0},{0,0,0},{0,0,0}},B[3][2] = {{0,0},{0,0},{0,0}};
+  for(i = 0; i < n; i++){
+    for(j = 0; j < 2; j++)t2[j] += s2D.db(i+j*n,0);
+    for(j = 0; j < 3; j++)t3[j] += s3D.db(i+j*n,0);
+  }
+  for(j = 0; j < 2; j++)t2[j] /= n; 
+  for(j = 0; j < 3; j++)t3[j] /= n;
+
+  //M = inv(S'*S)*S'*X of the centred shapes
+  for(i = 0; i < n; i++){
+    double X[2],S[3];
+    for(j = 0; j < 2; j++)X[j] = s2D.db(i+j*n,0) - t2[j];
+    for(j = 0; j < 3; j++)S[j] = s3D.db(i+j*n,0) - t3[j];
+    for(j = 0; j < 3; j++){
+      for(k = 0; k < 3; k++)A[j][k] += S[j]*S[k];
+      for(k = 0; k < 2; k++)B[j][k] += S[j]*X[k];
+    }
+  }
+  double Ai[3][3],M[3][2];
+  Ai[0][0] = A[1][1]*A[2][2] - A[1][2]*A[2][1];
+  Ai[0][1] = A[0][2]*A[2][1] - A[0][1]*A[2][2];
+  Ai[0][2] = A[0][1]*A[1][2] - A[0][2]*A[1][1];
+  Ai[1][0] = A[1][2]*A[2][0] - A[1][0]*A[2][2];
+  Ai[1][1] = A[0][0]*A[2][2] - A[0][2]*A[2][0];
+  Ai[1][2] = A[0][2]*A[1][0] - A[0][0]*A[1][2];
+  Ai[2][0] = A[1][0]*A[2][1] - A[1][1]*A[2][0];
+  Ai[2][1] = A[0][1]*A[2][0] - A[0][0]*A[2][1];
+  Ai[2][2] = A[0][0]*A[1][1] - A[0][1]*A[1][0];
+  double det = A[0][0]*Ai[0][0] + A[0][1]*Ai[1][0] + A[0][2]*Ai[2][0];
+  for(j = 0; j < 3; j++){
+    for(k = 0; k < 2; k++)
+      M[j][k] = (Ai[j][0]*B[0][k] + Ai[j][1]*B[1][k] + Ai[j][2]*B[2][k])/det;
+  }
+  //rows of the projection are inv(sqrtm(M'*M))*M', in closed form for 2x2
+  double a = 0,b = 0,c = 0;
+  for(j = 0; j < 3; j++){a += M[j][0]*M[j][0]; b += M[j][0]*M[j][1]; 
+    c += M[j][1]*M[j][1];}
+  double s = sqrt(a*c - b*b),t = sqrt(a + c + 2*s),r = 1.0/(s*t);
+  double N[2][2] = {{(c+s)*r,-b*r},{-b*r,(a+s)*r}};
+  double tm[9]; cv::Mat T(3,3,CV_64F,tm); scale = 0;
+  for(j = 0; j < 2; j++){
+    for(k = 0; k < 3; k++){
+      T.db(j,k) = N[j][0]*M[k][0] + N[j][1]*M[k][1]; scale += T.db(j,k)*M[k][j];
+    }
+  }
+  scale *= 0.5; AddOrthRow(T); Rot2Euler(T,pitch,yaw,roll); 
+  for(k = 0; k < 9; k++)tm[k] *= scale;
   x = t2[0] - (T.db(0,0)*t3[0] + T.db(0,1)*t3[1] + T.db(0,2)*t3[2]);
   y = t2[1] - (T.db(1,0)*t3[0] + T.db(1,1)*t3[1] + T.db(1,2)*t3[2]); return;
 }
@@ -209,6 +442,12 @@ PDM2D& PDM2D::operator= (PDM2D const&rhs)
   this->_M  = rhs._M.clone();  this->s_  = rhs.s_.clone(); return *this;
 }
 //=============================================================================
+void PDM2D::Share(PDM2D const&rhs)
+{
+  _n = rhs._n; _T = rhs._T; _V = rhs._V; _E = rhs._E; _M = rhs._M;
+  s_.create(_M.rows,1,CV_64F); return;
+}
+//=============================================================================
 void PDM2D::Write(ofstream &s, bool binary)
 {
   if(!binary){
@@ -242,7 +481,7 @@ void PDM2D::Read(ifstream &s,bool readType)
   _n = _M.rows/2; s_.create(_M.rows,1,CV_64F); return;
 }
 //=============================================================================
-void PDM2D::ReadBinary(ifstream &s,bool readType)
+void PDM2D::ReadBinary(istream &s,bool readType)
 {
   if(readType){int type; 
     s.read(reinterpret_cast<char*>(&type), sizeof(type));
@@ -408,7 +647,26 @@ PDM3D& PDM3D::operator= (PDM3D const& rhs)
   this->P_  = rhs.P_.clone();  this->Px_ = rhs.Px_.clone();
   this->Py_ = rhs.Py_.clone(); this->Pz_ = rhs.Pz_.clone();
   this->R1_ = rhs.R1_.clone(); this->R2_ = rhs.R2_.clone(); 
-  this->R3_ = rhs.R3_.clone(); return *this;
+  this->R3_ = rhs.R3_.clone(); this->p_  = rhs.p_.clone();
+  this->V32_ = rhs.V32_.clone(); return *this;
+}
+//=============================================================================
+void PDM3D::Share(PDM3D const& rhs)
+{
+  _n = rhs._n; _V = rhs._V; _E = rhs._E; _M = rhs._M;
+  S_.create(_M.rows,1,CV_64F);  
+  R_.create(3,3,CV_64F); s_.create(_M.rows,1,CV_64F); P_.create(2,3,CV_64F);
+  Px_.create(2,3,CV_64F); Py_.create(2,3,CV_64F); Pz_.create(2,3,CV_64F);
+  R1_.create(3,3,CV_64F); R2_.create(3,3,CV_64F); R3_.create(3,3,CV_64F);
+  p_.create(_V.cols,1,CV_64F); V32_ = rhs.V32_;
+  return;
+}
+//=============================================================================
+void PDM3D::SetPrecision(int type)
+{
+  if(type == CV_32F){if(V32_.empty())_V.convertTo(V32_,CV_32F);}
+  else V32_.release();
+  return;
 }
 //=============================================================================
 void PDM3D::Write(ofstream &s, bool binary)
@@ -437,10 +695,11 @@ void PDM3D::Read(ifstream &s,bool readType)
   R_.create(3,3,CV_64F); s_.create(_M.rows,1,CV_64F); P_.create(2,3,CV_64F);
   Px_.create(2,3,CV_64F); Py_.create(2,3,CV_64F); Pz_.create(2,3,CV_64F);
   R1_.create(3,3,CV_64F); R2_.create(3,3,CV_64F); R3_.create(3,3,CV_64F);
+  p_.create(_V.cols,1,CV_64F); V32_.release();
   return;
 }
 //===========================================================================
-void PDM3D::ReadBinary(ifstream &s,bool readType)
+void PDM3D::ReadBinary(istream &s,bool readType)
 {
   if(readType){int type; 
     s.read(reinterpret_cast<char*>(&type), sizeof(type));
@@ -454,6 +713,7 @@ void PDM3D::ReadBinary(ifstream &s,bool readType)
   R_.create(3,3,CV_64F); s_.create(_M.rows,1,CV_64F); P_.create(2,3,CV_64F);
   Px_.create(2,3,CV_64F); Py_.create(2,3,CV_64F); Pz_.create(2,3,CV_64F);
   R1_.create(3,3,CV_64F); R2_.create(3,3,CV_64F); R3_.create(3,3,CV_64F);
+  p_.create(_V.cols,1,CV_64F); V32_.release();
   return;
 }
 //===========================================================================
@@ -481,7 +741,7 @@ void PDM3D::CalcShape2D(cv::Mat &s,cv::Mat &plocal,cv::Mat &pglobl)
   assert((plocal.rows == _E.cols) && (plocal.cols == 1));
   assert((pglobl.rows == 6) && (pglobl.cols == 1));
   int n = _M.rows/3; double a=pglobl.db(0,0),x=pglobl.db(4,0),y=pglobl.db(5,0);
-  Euler2Rot(R_,pglobl); S_ = _M + _V*plocal;
+  Euler2Rot(R_,pglobl); this->CalcShape3D(S_,plocal);
   if((s.rows != 2*n) || (s.cols = 1))s.create(2*n,1,CV_64F);
   for(int i = 0; i < n; i++){
     s.db(i  ,0) = a*( R_.db(0,0)*S_.db(i    ,0) + R_.db(0,1)*S_.db(i+n  ,0) +
@@ -493,43 +753,61 @@ void PDM3D::CalcShape2D(cv::Mat &s,cv::Mat &plocal,cv::Mat &pglobl)
 //===========================================================================
 void PDM3D::CalcShape3D(cv::Mat &s,cv::Mat &plocal)
 {
-  assert((s.type() == CV_64F) && (plocal.type() == CV_64F));
-  assert((s.rows == _M.rows) && (s.cols = 1));
-  assert((plocal.rows == _E.cols) && (plocal.cols == 1));
-  s = _M + _V*plocal; return;
+  assert((plocal.type() == CV_64F) && (plocal.rows == _E.cols) && 
+	 (plocal.cols == 1));
+  if((s.rows != _M.rows) || (s.cols != 1) || (s.type() != CV_64F))
+    s.create(_M.rows,1,CV_64F);
+  if(V32_.empty())LinearShape<double>(_M,_V,plocal,s);
+  else LinearShape<float>(_M,V32_,plocal,s);
+  return;
 }
 //===========================================================================
 void PDM3D::CalcParams(cv::Mat &s,cv::Mat &plocal,cv::Mat &pglobl)
+{
+  if((plocal.rows != _V.cols) || (plocal.cols != 1) || 
+     (plocal.type() != CV_64F))plocal.create(_V.cols,1,CV_64F);
+  plocal = cv::Scalar(0); this->CalcParams(s,plocal,pglobl,100); return;
+}
+//===========================================================================
+int PDM3D::CalcParams(cv::Mat &s,cv::Mat &plocal,cv::Mat &pglobl,
+		      int nIter,double fTol)
 {
   assert((s.type() == CV_64F) && (s.rows == 2*(_M.rows/3)) && (s.cols = 1));
   if((pglobl.rows != 6) || (pglobl.cols != 1) || (pglobl.type() != CV_64F))
     pglobl.create(6,1,CV_64F);
-  int j,n = _M.rows/3; double si,scale,pitch,yaw,roll,tx,ty,Tx,Ty,Tz; 
-  cv::Mat R(3,3,CV_64F),z(n,1,CV_64F),t(3,1,CV_64F),p(_V.cols,1,CV_64F);  
-  cv::Mat r = R.row(2), S(this->nPoints(),3,CV_64F);
-  plocal = cv::Mat::zeros(_V.cols,1,CV_64F); 
-  for(int iter = 0; iter < 100; iter++){
+  if((plocal.rows != _V.cols) || (plocal.cols != 1) || 
+     (plocal.type() != CV_64F)){
+    plocal.create(_V.cols,1,CV_64F); plocal = cv::Scalar(0);
+  }
+  int j,iter,n = _M.rows/3,m = _V.cols; 
+  double si,z,d,scale,pitch,yaw,roll,tx,ty,Tx,Ty,Tz,r[9];
+  cv::Mat R(3,3,CV_64F,r); plocal.copyTo(p_);
+  for(iter = 0; iter < std::max(nIter,1);){
     this->CalcShape3D(S_,plocal);
     Align3Dto2DShapes(scale,pitch,yaw,roll,tx,ty,s,S_);
-    Euler2Rot(R,pitch,yaw,roll); S = (S_.reshape(1,3)).t();
-    z = scale*S*r.t(); si = 1.0/scale; 
-    Tx = -si*(R.db(0,0)*tx + R.db(1,0)*ty);
-    Ty = -si*(R.db(0,1)*tx + R.db(1,1)*ty);
-    Tz = -si*(R.db(0,2)*tx + R.db(1,2)*ty);
+    Euler2Rot(R,pitch,yaw,roll); si = 1.0/scale; 
+    Tx = -si*(r[0]*tx + r[3]*ty);
+    Ty = -si*(r[1]*tx + r[4]*ty);
+    Tz = -si*(r[2]*tx + r[5]*ty);
     for(j = 0; j < n; j++){
-      t.db(0,0) = s.db(j,0); t.db(1,0) = s.db(j+n,0); t.db(2,0) = z.db(j,0);
-      S_.db(j    ,0) = si*t.dot(R.col(0))+Tx;
-      S_.db(j+n  ,0) = si*t.dot(R.col(1))+Ty;
-      S_.db(j+n*2,0) = si*t.dot(R.col(2))+Tz;
+      z = scale*(r[6]*S_.db(j,0) + r[7]*S_.db(j+n,0) + r[8]*S_.db(j+n*2,0));
+      double x = s.db(j,0),y = s.db(j+n,0);
+      S_.db(j    ,0) = si*(x*r[0] + y*r[3] + z*r[6])+Tx;
+      S_.db(j+n  ,0) = si*(x*r[1] + y*r[4] + z*r[7])+Ty;
+      S_.db(j+n*2,0) = si*(x*r[2] + y*r[5] + z*r[8])+Tz;
     }
-    plocal = _V.t()*(S_-_M); 
-    if(iter > 0){if(cv::norm(plocal-p) < 1.0e-5)break;}
-    plocal.copyTo(p);
+    if(V32_.empty())LinearParams<double>(_M,_V,S_,plocal);
+    else LinearParams<float>(_M,V32_,S_,plocal);
+    for(j = 0,d = 0.0; j < m; j++){
+      double e = plocal.db(j,0) - p_.db(j,0); d += e*e;
+    }
+    iter++; if(sqrt(d) < fTol)break;
+    plocal.copyTo(p_);
   }
   pglobl.db(0,0) = scale; pglobl.db(1,0) = pitch;
   pglobl.db(2,0) = yaw;   pglobl.db(3,0) = roll;
   pglobl.db(4,0) = tx;    pglobl.db(5,0) = ty;
-  return;
+  return iter;
 }
 //===========================================================================
 void PDM3D::CalcParams3D(cv::Mat &s,cv::Mat &plocal,cv::Mat &pglobl)
@@ -573,7 +851,8 @@ void PDM3D::Init(cv::Mat &M,cv::Mat &V,cv::Mat &E)
   S_.create(_M.rows,1,CV_64F);  
   R_.create(3,3,CV_64F); s_.create(_M.rows,1,CV_64F); P_.create(2,3,CV_64F);
   Px_.create(2,3,CV_64F); Py_.create(2,3,CV_64F); Pz_.create(2,3,CV_64F);
-  R1_.create(3,3,CV_64F); R2_.create(3,3,CV_64F); R3_.create(3,3,CV_64F);  
+  R1_.create(3,3,CV_64F); R2_.create(3,3,CV_64F); R3_.create(3,3,CV_64F);
+  p_.create(_V.cols,1,CV_64F); V32_.release();
   return;
 }
 //===========================================================================
@@ -585,7 +864,7 @@ void PDM3D::Identity(cv::Mat &plocal,cv::Mat &pglobl)
 //===========================================================================
 void PDM3D::CalcJacob(cv::Mat &plocal,cv::Mat &pglobl,cv::Mat &Jacob)
 {
-  int i,j,n = _M.rows/3,m = _V.cols; double X,Y,Z;
+  int i,n = _M.rows/3,m = _V.cols; double X,Y,Z;
   assert((plocal.rows == m)  && (plocal.cols == 1) && 
 	 (pglobl.rows == 6)  && (pglobl.cols == 1) &&
 	 (Jacob.rows == 2*n) && (Jacob.cols == 6+m));
@@ -594,7 +873,8 @@ void PDM3D::CalcJacob(cv::Mat &plocal,cv::Mat &pglobl,cv::Mat &Jacob)
   double ry[3][3] = {{0,0,1},{0,0,0},{-1,0,0}}; cv::Mat Ry(3,3,CV_64F,ry);
   double rz[3][3] = {{0,-1,0},{1,0,0},{0,0,0}}; cv::Mat Rz(3,3,CV_64F,rz);
   this->CalcShape3D(S_,plocal); Euler2Rot(R_,pglobl); 
-  P_ = s*R_(cv::Rect(0,0,3,2)); Px_ = P_*Rx; Py_ = P_*Ry; Pz_ = P_*Rz;
+  for(int k = 0; k < 6; k++)P_.db(k/3,k%3) = s*R_.db(k/3,k%3);
+  MulSmall(P_,Rx,Px_); MulSmall(P_,Ry,Py_); MulSmall(P_,Rz,Pz_);
   assert(R_.isContinuous() && Px_.isContinuous() && 
 	 Py_.isContinuous() && Pz_.isContinuous() && P_.isContinuous());
   const double* px = Px_.ptr<double>(0);
@@ -602,26 +882,20 @@ void PDM3D::CalcJacob(cv::Mat &plocal,cv::Mat &pglobl,cv::Mat &Jacob)
   const double* pz = Pz_.ptr<double>(0);
   const double* p  =  P_.ptr<double>(0);
   const double* r  =  R_.ptr<double>(0);
-  cv::MatIterator_<double> Jx =  Jacob.begin<double>();
-  cv::MatIterator_<double> Jy =  Jx + n*(6+m);
-  cv::MatIterator_<double> Vx =  _V.begin<double>();
-  cv::MatIterator_<double> Vy =  Vx + n*m;
-  cv::MatIterator_<double> Vz =  Vy + n*m;
   for(i = 0; i < n; i++){
+    double* Jx = Jacob.ptr<double>(i); double* Jy = Jacob.ptr<double>(i+n);
     X=S_.db(i,0); Y=S_.db(i+n,0); Z=S_.db(i+n*2,0);    
-    *Jx++ =  r[0]*X +  r[1]*Y +  r[2]*Z;
-    *Jy++ =  r[3]*X +  r[4]*Y +  r[5]*Z;
-    *Jx++ = px[0]*X + px[1]*Y + px[2]*Z;
-    *Jy++ = px[3]*X + px[4]*Y + px[5]*Z;
-    *Jx++ = py[0]*X + py[1]*Y + py[2]*Z;
-    *Jy++ = py[3]*X + py[4]*Y + py[5]*Z;
-    *Jx++ = pz[0]*X + pz[1]*Y + pz[2]*Z;
-    *Jy++ = pz[3]*X + pz[4]*Y + pz[5]*Z;
-    *Jx++ = 1.0; *Jy++ = 0.0; *Jx++ = 0.0; *Jy++ = 1.0;
-    for(j = 0; j < m; j++,++Vx,++Vy,++Vz){
-      *Jx++ = p[0]*(*Vx) + p[1]*(*Vy) + p[2]*(*Vz);
-      *Jy++ = p[3]*(*Vx) + p[4]*(*Vy) + p[5]*(*Vz);
-    }
+    Jx[0] =  r[0]*X +  r[1]*Y +  r[2]*Z;
+    Jy[0] =  r[3]*X +  r[4]*Y +  r[5]*Z;
+    Jx[1] = px[0]*X + px[1]*Y + px[2]*Z;
+    Jy[1] = px[3]*X + px[4]*Y + px[5]*Z;
+    Jx[2] = py[0]*X + py[1]*Y + py[2]*Z;
+    Jy[2] = py[3]*X + py[4]*Y + py[5]*Z;
+    Jx[3] = pz[0]*X + pz[1]*Y + pz[2]*Z;
+    Jy[3] = pz[3]*X + pz[4]*Y + pz[5]*Z;
+    Jx[4] = 1.0; Jy[4] = 0.0; Jx[5] = 0.0; Jy[5] = 1.0;
+    if(V32_.empty())ModeJacob<double>(p,_V,i,n,Jx+6,Jy+6);
+    else ModeJacob<float>(p,V32_,i,n,Jx+6,Jy+6);
   }return;
 }
 //===========================================================================
@@ -636,7 +910,8 @@ void PDM3D::CalcRigidJacob(cv::Mat &plocal,cv::Mat &pglobl,cv::Mat &Jacob)
   double rz[3][3] = {{0,-1,0},{1,0,0},{0,0,0}}; cv::Mat Rz(3,3,CV_64F,rz);
   double s = pglobl.db(0,0);
   this->CalcShape3D(S_,plocal); Euler2Rot(R_,pglobl); 
-  P_ = s*R_(cv::Rect(0,0,3,2)); Px_ = P_*Rx; Py_ = P_*Ry; Pz_ = P_*Rz;
+  for(int k = 0; k < 6; k++)P_.db(k/3,k%3) = s*R_.db(k/3,k%3);
+  MulSmall(P_,Rx,Px_); MulSmall(P_,Ry,Py_); MulSmall(P_,Rz,Pz_);
   assert(R_.isContinuous() && Px_.isContinuous() && 
 	 Py_.isContinuous() && Pz_.isContinuous());
   const double* px = Px_.ptr<double>(0);
@@ -670,7 +945,7 @@ void PDM3D::CalcReferenceUpdate(cv::Mat &dp,cv::Mat &plocal,cv::Mat &pglobl)
   R2_.db(1,2) = -1.0*(R2_.db(2,1) = dp.db(1,0));
   R2_.db(2,1) = -1.0*(R2_.db(0,2) = dp.db(2,0));
   R2_.db(0,1) = -1.0*(R2_.db(1,0) = dp.db(3,0));
-  MetricUpgrade(R2_); R3_ = R1_*R2_; Rot2Euler(R3_,pglobl); return;
+  MetricUpgrade(R2_); MulSmall(R1_,R2_,R3_); Rot2Euler(R3_,pglobl); return;
 }
 //===========================================================================
 void PDM3D::ApplySimT(double a,double b,double tx,double ty,cv::Mat &pglobl)
@@ -689,7 +964,7 @@ void PDM3D::ApplySimT(double a,double b,double tx,double ty,cv::Mat &pglobl)
   R1_.db(1,0) =  sa;
   R1_.db(1,1) =  ca;
   Euler2Rot(R2_,pglobl);
-  R3_ = R1_*R2_; 
+  MulSmall(R1_,R2_,R3_);
   pglobl.db(0,0) *= scale;
   Rot2Euler(R3_,pglobl);
   pglobl.db(4,0) = a*xc - b*yc + tx;
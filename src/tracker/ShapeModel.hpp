@@ -27,6 +27,11 @@ namespace FACETRACKER
   void GramSchmidt(cv::Mat &m);
   void AddOrthRow(cv::Mat &R);
   void MetricUpgrade(cv::Mat &R);
+  void AddJtJ(cv::Mat &J,double w,cv::Mat &H);          //H += w*J'*J
+  void AddJtr(cv::Mat &J,cv::Mat &r,double w,cv::Mat &g); //g += w*J'*r
+  void AddShapePrior(cv::Mat &E,cv::Mat &p,double w,    //H += w*inv(E),
+		     cv::Mat &H,cv::Mat &g);             //g -= w*inv(E)*p
+  bool CholSolve(cv::Mat &H,cv::Mat &g,cv::Mat &x);     //H*x = g, destroys H
   void Euler2Rot(cv::Mat &R,const double pitch,const double yaw,
 		 const double roll,bool full = true);
   void Euler2Rot(cv::Mat &R,cv::Mat &p,bool full = true);
@@ -56,7 +61,7 @@ namespace FACETRACKER
     }
     virtual void Write(std::ofstream &s, bool binary = false) = 0;
     virtual void Read(std::ifstream &s,bool readType = true) = 0;
-    virtual void ReadBinary(std::ifstream &s,bool readType = true) = 0;
+    virtual void ReadBinary(std::istream &s,bool readType = true) = 0;
     virtual void CalcShape(cv::Mat &s,cv::Mat &params) = 0;
     virtual void CalcParams(cv::Mat &s,cv::Mat &params) = 0;
     virtual void CalcJacob(cv::Mat &params,cv::Mat &Jacob) = 0;    
@@ -105,10 +110,11 @@ namespace FACETRACKER
     PDM2D(const char* fname, bool binary = false){_type = IO::PDM2D; this->Load(fname, binary);}
     PDM2D(cv::Mat &M,cv::Mat &V,cv::Mat &E){_type=IO::PDM2D; this->Init(M,V,E);}
     PDM2D& operator=(PDM2D const&rhs);
+    void Share(PDM2D const&rhs); /**< share model data, own scratch memory */
 
     void Write(std::ofstream &s, bool binary = false);
     void Read(std::ifstream &s,bool readType = true);
-    void ReadBinary(std::ifstream &s,bool readType = true);
+    void ReadBinary(std::istream &s,bool readType = true);
     void CalcShape2D(cv::Mat &s,cv::Mat &plocal,cv::Mat &pglobl);
     void CalcParams(cv::Mat &s,cv::Mat &plocal,cv::Mat &pglobl);
     void Init(cv::Mat &M,cv::Mat &V,cv::Mat &E);
@@ -132,13 +138,20 @@ namespace FACETRACKER
     PDM3D(const char* fname, bool binary = false){_type = IO::PDM3D; this->Load(fname, binary);}
     PDM3D(cv::Mat &M,cv::Mat &V,cv::Mat &E){_type=IO::PDM3D; this->Init(M,V,E);}
     PDM3D& operator=(PDM3D const&rhs);
+    void Share(PDM3D const&rhs); /**< share model data, own scratch memory */
 
     void Write(std::ofstream &s, bool binary = false);
     void Read(std::ifstream &s,bool readType = true);
-    void ReadBinary(std::ifstream &s,bool readType = true);
+    void ReadBinary(std::istream &s,bool readType = true);
     void CalcShape2D(cv::Mat &s,cv::Mat &plocal,cv::Mat &pglobl);
     void CalcShape3D(cv::Mat &s,cv::Mat &plocal);
     void CalcParams(cv::Mat &s,cv::Mat &plocal,cv::Mat &pglobl);
+    int                         //number of iterations run
+    CalcParams(cv::Mat &s,      //2D shape to fit
+	       cv::Mat &plocal, //starting point on entry, unless mis-sized
+	       cv::Mat &pglobl, //pose on return
+	       int nIter,       //maximum number of iterations
+	       double fTol = 1.0e-5); //convergence tolerance on plocal
     void CalcParams3D(cv::Mat &s,cv::Mat &plocal,cv::Mat &pglobl);
     void Init(cv::Mat &M,cv::Mat &V,cv::Mat &E);
     void Identity(cv::Mat &plocal,cv::Mat &pglobl);
@@ -148,8 +161,11 @@ namespace FACETRACKER
     void ApplySimT(double a,double b,double tx,double ty,cv::Mat &pglobl);
     void Project2D(cv::Mat &s,cv::Mat &S,cv::Mat &pglobl);
     const cv::Mat currentShape3D() const; 
+    void SetPrecision(int type); /**< CV_32F keeps a float copy of _V */
+    inline int Precision(){return V32_.empty() ? CV_64F : CV_32F;}
   private:
-    cv::Mat S_,R_,s_,P_,Px_,Py_,Pz_,R1_,R2_,R3_;
+    cv::Mat S_,R_,s_,P_,Px_,Py_,Pz_,R1_,R2_,R3_,p_;
+    cv::Mat V32_; //float basis used when non-empty
   };
   //===========================================================================
 }
@@ -19,11 +19,25 @@
 
 #include <tracker/ShapePredictor.hpp>
 #include <tracker/CLM.hpp>
+#include <tracker/ThreadPool.hpp>
 #define db at<double>
 #define it at<int>
 using namespace FACETRACKER;
 using namespace std;
 //=============================================================================
+//y = R*x, with R and x of type T
+template <typename T> static void 
+MulVec(cv::Mat &R,cv::Mat &x,cv::Mat &y)
+{
+  assert((R.cols == x.rows) && (R.rows == y.rows) && x.isContinuous());
+  const T* px = x.ptr<T>(0);
+  for(int i = 0; i < R.rows; i++){
+    const T* r = R.ptr<T>(i); T v = 0;
+    for(int j = 0; j < R.cols; j++)v += r[j]*px[j];
+    y.db(i,0) = v;
+  }return;
+}
+//=============================================================================
 ShapePredictor& ShapePredictor::operator= (ShapePredictor const&rhs)
 {
   _K = rhs._K;
@@ -36,6 +50,8 @@ ShapePredictor& ShapePredictor::operator= (ShapePredictor const&rhs)
     _C[i] = rhs._C[i].clone();
     _R[i] = rhs._R[i].clone();
   }
+  R32_.resize(rhs.R32_.size());
+  for(size_t i = 0; i < R32_.size(); i++)R32_[i] = rhs.R32_[i].clone();
   x_.create(_warp._nPix+1,1,CV_64F);
   y_.create(2*_idx.rows,1,CV_64F);
   z_.create(2*_idx.rows,1,CV_64F);
@@ -43,6 +59,18 @@ ShapePredictor& ShapePredictor::operator= (ShapePredictor const&rhs)
   pglobl_.create(4,1,CV_64F); return *this;
 }
 //==============================================================================
+void ShapePredictor::Share(ShapePredictor const&rhs)
+{
+  _K = rhs._K; _idx = rhs._idx; _rect = rhs._rect; _C = rhs._C; _R = rhs._R;
+  R32_ = rhs.R32_;
+  _pdm.Share(rhs._pdm); _warp.Share(rhs._warp);
+  x_.create(_warp._nPix+1,1,CV_64F);
+  y_.create(2*_idx.rows,1,CV_64F);
+  z_.create(2*_idx.rows,1,CV_64F);
+  plocal_.create(_pdm.nModes(),1,CV_64F);
+  pglobl_.create(4,1,CV_64F); return;
+}
+//==============================================================================
 void ShapePredictor::Load(const char* fname, bool binary)
 {
   ifstream s;
@@ -72,7 +100,7 @@ void ShapePredictor::Read(ifstream &s)
     FACETRACKER::IO::ReadMat(s,_R[i]);
   }
   FACETRACKER::IO::ReadMat(s,_idx);
-  _pdm.Read(s); _warp.Read(s);
+  _pdm.Read(s); _warp.Read(s); R32_.clear();
   s >> _rect.x >> _rect.y >> _rect.width >> _rect.height;
 
   x_.create(_warp._nPix+1,1,CV_64F);
@@ -82,7 +110,7 @@ void ShapePredictor::Read(ifstream &s)
   pglobl_.create(4,1,CV_64F); return;
 }
 //==============================================================================
-void ShapePredictor::ReadBinary(ifstream &s, bool readType)
+void ShapePredictor::ReadBinary(istream &s, bool readType)
 {
 
   if(readType){int type; 
@@ -97,7 +125,7 @@ void ShapePredictor::ReadBinary(ifstream &s, bool readType)
     FACETRACKER::IOBinary::ReadMat(s,_R[i]);
   }
   FACETRACKER::IOBinary::ReadMat(s,_idx);
-  _pdm.ReadBinary(s); _warp.ReadBinary(s);
+  _pdm.ReadBinary(s); _warp.ReadBinary(s); R32_.clear();
   s.read(reinterpret_cast<char*>(&_rect), sizeof(_rect));
   
   x_.create(_warp._nPix+1,1,CV_64F);
@@ -143,7 +171,8 @@ cv::Mat ShapePredictor::Predict(cv::Mat &shape,cv::Mat &im)
   equalizeHist(img,img);
   cv::Mat x = x_(cv::Rect(0,0,1,_warp._nPix));
   _warp.Vectorize(crop_,x); cv::normalize(x,x); x_.db(_warp._nPix,0) = 1.0;
-  y_ = _R[k]*x_; 
+  if(R32_.empty())MulVec<double>(_R[k],x_,y_);
+  else{x_.convertTo(xf_,CV_32F); MulVec<float>(R32_[k],xf_,y_);}
   for(int i = 0; i < n; i++){
     y_.db(i  ,0) += _warp._xmin;
     y_.db(i+n,0) += _warp._ymin;
@@ -153,6 +182,18 @@ cv::Mat ShapePredictor::Predict(cv::Mat &shape,cv::Mat &im)
   return z_;
 }
 //==============================================================================
+void ShapePredictor::SetPrecision(int type)
+{
+  if(type == CV_32F){
+    if(R32_.empty()){
+      R32_.resize(_K);
+      for(int i = 0; i < _K; i++)_R[i].convertTo(R32_[i],CV_32F);
+    }
+    xf_.create(_warp._nPix+1,1,CV_32F);
+  }else R32_.clear();
+  return;
+}
+//==============================================================================
 int ShapePredictor::FindCluster(cv::Mat &shape)
 {
   int n = _idx.rows;
@@ -206,7 +247,7 @@ void ShapePredictorList::Read(ifstream &s)
 }
 //==============================================================================
 //===========================================================================
-void ShapePredictorList::ReadBinary(ifstream &s, bool readType)
+void ShapePredictorList::ReadBinary(istream &s, bool readType)
 {
   int N; 
 
@@ -237,19 +278,40 @@ void ShapePredictorList::Write(ofstream &s, bool binary)
   return;
 }
 //==============================================================================
+void ShapePredictorList::Share(ShapePredictorList const&rhs)
+{
+  _pred.resize(rhs._pred.size());
+  for(size_t i = 0; i < rhs._pred.size(); i++)_pred[i].Share(rhs._pred[i]);
+  return;
+}
+//==============================================================================
+void ShapePredictorList::SetPrecision(int type)
+{
+  for(size_t i = 0; i < _pred.size(); i++)_pred[i].SetPrecision(type);
+  return;
+}
+//==============================================================================
+//points of the shape predicted by each predictor, all from the same input
+struct PredictBody : public ParallelBody{
+  vector<ShapePredictor> &pred; cv::Mat &in,&shape,&im;
+  PredictBody(vector<ShapePredictor> &p,cv::Mat &x,cv::Mat &s,cv::Mat &i)
+    : pred(p),in(x),shape(s),im(i){;}
+  void operator()(int begin,int end){
+    for(int i = begin; i < end; i++){
+      cv::Mat s = pred[i].Predict(in,im);
+      int n = pred[i]._idx.rows;
+      for(int j = 0; j < n; j++){
+	shape.db(pred[i]._idx.it(j,0)             ,0) = s.db(j  ,0);
+	shape.db(pred[i]._idx.it(j,0)+shape.rows/2,0) = s.db(j+n,0);
+      }
+    }return;
+  }
+};
+//==============================================================================
 void ShapePredictorList::Predict(cv::Mat &shape,cv::Mat &im)
 {
-  size_t i;
-#ifdef _OPENMP
-#pragma omp parallel for
-#endif
-  for(i = 0; i < _pred.size(); i++){
-    cv::Mat s = _pred[i].Predict(shape,im);
-    int n = _pred[i]._idx.rows;
-    for(int j = 0; j < n; j++){
-      shape.db(_pred[i]._idx.it(j,0)             ,0) = s.db(j  ,0);
-      shape.db(_pred[i]._idx.it(j,0)+shape.rows/2,0) = s.db(j+n,0);
-    }
-  }return;
+  shape.copyTo(in_);
+  PredictBody body(_pred,in_,shape,im); ParallelFor(0,_pred.size(),body);
+  return;
 }
 //==============================================================================
@@ -36,14 +36,17 @@ namespace FACETRACKER
     ShapePredictor(){;}
     ShapePredictor(const char* fname, bool binary = false){this->Load(fname, binary);}
     ShapePredictor& operator=(ShapePredictor const&rhs);
+    void Share(ShapePredictor const&rhs); //share model, own scratch memory
     void Load(const char* fname, bool binary = false);
     void Save(const char* fname, bool binary = false);
     void Read(std::ifstream &s);
-    void ReadBinary(std::ifstream &se, bool readType = true);
+    void ReadBinary(std::istream &se, bool readType = true);
     void Write(std::ofstream &s, bool binary = false);
     cv::Mat Predict(cv::Mat &shape,cv::Mat &im);
+    void SetPrecision(int type); //CV_32F keeps float copies of _R
   protected:
-    cv::Mat crop_,x_,z_,y_,plocal_,pglobl_;
+    std::vector<cv::Mat> R32_; //float regressors used when non-empty
+    cv::Mat crop_,x_,xf_,z_,y_,plocal_,pglobl_;
     int FindCluster(cv::Mat &shape);
   };
   //===========================================================================
@@ -52,12 +55,16 @@ namespace FACETRACKER
     std::vector<ShapePredictor> _pred;
     ShapePredictorList(){;}
     ShapePredictorList(const char* fname, bool binary = false){this->Load(fname, binary);}
+    void Share(ShapePredictorList const&rhs);
     void Load(const char* fname, bool binary = false);
     void Save(const char* fname, bool binary = false);
     void Read(std::ifstream &s);
-    void ReadBinary(std::ifstream &s, bool readType = true);
+    void ReadBinary(std::istream &s, bool readType = true);
     void Write(std::ofstream &s, bool binary = false);
     void Predict(cv::Mat &shape,cv::Mat &im);
+    void SetPrecision(int type);
+  private:
+    cv::Mat in_; /**< Input shape every predictor reads from             */
   };
   //===========================================================================
 }
@@ -0,0 +1,203 @@
+// CSIRO has filed various patents which cover the Software. 
+
+// CSIRO grants to you a license to any patents granted for inventions
+// implemented by the Software for academic, research and non-commercial
+// use only.
+
+// CSIRO hereby reserves all rights to its inventions implemented by the
+// Software and any patents subsequently granted for those inventions
+// that are not expressly granted to you.  Should you wish to license the
+// patents relating to the Software for commercial use please contact
+// CSIRO IP & Licensing, Gautam Tendulkar (gautam.tendulkar@csiro.au) or
+// Nick Marsh (nick.marsh@csiro.au)
+
+// This software is provided under the CSIRO OPEN SOURCE LICENSE
+// (GPL2) which can be found in the LICENSE file located in the top
+// most directory of the source code.
+
+// Copyright CSIRO 2013
+
+#include <tracker/ThreadPool.hpp>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+using namespace FACETRACKER;
+using namespace std;
+//===========================================================================
+static pthread_key_t budget_key_;
+static pthread_once_t budget_once_ = PTHREAD_ONCE_INIT;
+static void MakeBudgetKey(){pthread_key_create(&budget_key_,NULL);}
+//===========================================================================
+static void SetBudget(int n)
+{
+  pthread_once(&budget_once_,&MakeBudgetKey);
+  pthread_setspecific(budget_key_,reinterpret_cast<void*>(size_t(n)));
+  return;
+}
+//===========================================================================
+int ThreadBudget::Current()
+{
+  pthread_once(&budget_once_,&MakeBudgetKey);
+  return int(reinterpret_cast<size_t>(pthread_getspecific(budget_key_)));
+}
+//===========================================================================
+ThreadBudget::ThreadBudget(int n)
+{
+  prev_ = Current();
+  if(n > 0)SetBudget((prev_ > 0) ? std::min(n,prev_) : n);
+}
+//===========================================================================
+ThreadBudget::~ThreadBudget()
+{
+  SetBudget(prev_);
+}
+//===========================================================================
+void FACETRACKER::ParallelFor(int begin,int end,ParallelBody &body)
+{
+  if(end <= begin)return;
+#if defined(WITH_THREAD_POOL)
+  ThreadPool::Shared().Run(begin,end,body,ThreadBudget::Current());
+#elif defined(_OPENMP)
+  int n = ThreadBudget::Current(); if(n <= 0)n = omp_get_max_threads();
+#pragma omp parallel for num_threads(n) schedule(dynamic)
+  for(int i = begin; i < end; i++)body(i,i+1);
+#else
+  body(begin,end);
+#endif
+  return;
+}
+//===========================================================================
+static ThreadPool* pool_ = NULL;
+static pthread_once_t pool_once_ = PTHREAD_ONCE_INIT;
+//===========================================================================
+void ThreadPool::Create()
+{
+  pool_ = new ThreadPool; return;
+}
+//===========================================================================
+ThreadPool& ThreadPool::Shared()
+{
+  pthread_once(&pool_once_,&ThreadPool::Create); return *pool_;
+}
+//===========================================================================
+ThreadPool::ThreadPool()
+{
+  pthread_mutex_init(&lock_,NULL); pthread_cond_init(&cond_,NULL); 
+  quit_ = false; long n = sysconf(_SC_NPROCESSORS_ONLN);
+  this->Resize((n > 1) ? int(n-1) : 0);
+}
+//===========================================================================
+int ThreadPool::Size()
+{
+  pthread_mutex_lock(&lock_); int n = thread_.size();
+  pthread_mutex_unlock(&lock_); return n;
+}
+//===========================================================================
+void ThreadPool::Resize(int n)
+{
+  this->Stop(); 
+  pthread_mutex_lock(&lock_); quit_ = false;
+  for(int i = 0; i < n; i++){
+    pthread_t t;
+    if(pthread_create(&t,NULL,&ThreadPool::Main,this) != 0){
+      printf("ERROR(%s,%d) : Failed to start a worker thread\n",
+	     __FILE__,__LINE__); abort();
+    }
+    thread_.push_back(t);
+  }
+  pthread_mutex_unlock(&lock_); return;
+}
+//===========================================================================
+void ThreadPool::Stop()
+{
+  //workers finish the job in hand, loops in flight complete on the caller
+  pthread_mutex_lock(&lock_);
+  vector<pthread_t> threads; threads.swap(thread_);
+  quit_ = true; pthread_cond_broadcast(&cond_);
+  pthread_mutex_unlock(&lock_);
+  for(size_t i = 0; i < threads.size(); i++)pthread_join(threads[i],NULL);
+  return;
+}
+//===========================================================================
+void ThreadPool::Run(int begin,int end,ParallelBody &body,int nthreads)
+{
+  int n = end - begin; if(n <= 0)return;
+  int k = this->Size() + 1; if(nthreads > 0)k = std::min(k,nthreads);
+  k = std::min(k,n); if(k <= 1){body(begin,end); return;}
+
+  //one range per thread, the caller taking the first
+  Job job; job.body = &body; job.part.resize(k);
+  for(int i = 0; i < k; i++){
+    job.part[i].lo = begin + (long(n)*i)/k;
+    job.part[i].hi = begin + (long(n)*(i+1))/k;
+  }
+  job.grain = std::max(1,n/(4*k)); job.slots = k-1; job.next = 1; 
+  job.running = 0;
+  pthread_mutex_init(&job.lock,NULL); pthread_cond_init(&job.done,NULL);
+  pthread_mutex_lock(&lock_); 
+  queue_.push_back(&job); pthread_cond_broadcast(&cond_);
+  pthread_mutex_unlock(&lock_);
+
+  this->Work(&job,0);
+
+  //withdraw the parts nobody took, then wait for the workers that did
+  pthread_mutex_lock(&lock_);
+  deque<Job*>::iterator it = std::find(queue_.begin(),queue_.end(),&job);
+  if(it != queue_.end())queue_.erase(it);
+  pthread_mutex_unlock(&lock_);
+  pthread_mutex_lock(&job.lock);
+  while(job.running > 0)pthread_cond_wait(&job.done,&job.lock);
+  pthread_mutex_unlock(&job.lock);
+  pthread_cond_destroy(&job.done); pthread_mutex_destroy(&job.lock); return;
+}
+//===========================================================================
+void ThreadPool::Work(Job* job,int p)
+{
+  Part &own = job->part[p]; int lo,hi;
+  while(true){
+    pthread_mutex_lock(&job->lock);
+    if(own.lo >= own.hi){
+      //steal the upper half of the largest range left
+      int q = -1,m = 0;
+      for(int i = 0; i < int(job->part.size()); i++){
+	if(job->part[i].hi - job->part[i].lo > m){
+	  m = job->part[i].hi - job->part[i].lo; q = i;
+	}
+      }
+      if(q < 0){pthread_mutex_unlock(&job->lock); break;}
+      Part &other = job->part[q]; int mid = other.hi - (m+1)/2;
+      own.lo = mid; own.hi = other.hi; other.hi = mid;
+    }
+    lo = own.lo; hi = std::min(own.hi,lo + job->grain); own.lo = hi;
+    pthread_mutex_unlock(&job->lock);
+    (*job->body)(lo,hi);
+  }return;
+}
+//===========================================================================
+void* ThreadPool::Main(void* self)
+{
+  ThreadPool* pool = static_cast<ThreadPool*>(self); SetBudget(1);
+  pthread_mutex_lock(&pool->lock_);
+  while(true){
+    while(!pool->quit_ && pool->queue_.empty())
+      pthread_cond_wait(&pool->cond_,&pool->lock_);
+    if(pool->quit_)break;
+    Job* job = pool->queue_.front(); 
+    pthread_mutex_lock(&job->lock); 
+    int p = job->next++; job->running++;
+    pthread_mutex_unlock(&job->lock);
+    if(--job->slots == 0)pool->queue_.pop_front();
+    pthread_mutex_unlock(&pool->lock_);
+    pool->Work(job,p);
+    pthread_mutex_lock(&job->lock);
+    if(--job->running == 0)pthread_cond_broadcast(&job->done);
+    pthread_mutex_unlock(&job->lock);
+    pthread_mutex_lock(&pool->lock_);
+  }
+  pthread_mutex_unlock(&pool->lock_); return NULL;
+}
+//===========================================================================
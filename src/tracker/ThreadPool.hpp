@@ -0,0 +1,94 @@
+// CSIRO has filed various patents which cover the Software. 
+
+// CSIRO grants to you a license to any patents granted for inventions
+// implemented by the Software for academic, research and non-commercial
+// use only.
+
+// CSIRO hereby reserves all rights to its inventions implemented by the
+// Software and any patents subsequently granted for those inventions
+// that are not expressly granted to you.  Should you wish to license the
+// patents relating to the Software for commercial use please contact
+// CSIRO IP & Licensing, Gautam Tendulkar (gautam.tendulkar@csiro.au) or
+// Nick Marsh (nick.marsh@csiro.au)
+
+// This software is provided under the CSIRO OPEN SOURCE LICENSE
+// (GPL2) which can be found in the LICENSE file located in the top
+// most directory of the source code.
+
+// Copyright CSIRO 2013
+
+#ifndef _TRACKER_ThreadPool_h_
+#define _TRACKER_ThreadPool_h_
+#include <tracker/Config.h>
+#include <pthread.h>
+#include <deque>
+#include <vector>
+namespace FACETRACKER
+{
+  //===========================================================================
+  /** The body of a parallel loop, run on sub-ranges of its iterations */
+  class ParallelBody{
+  public:
+    virtual ~ParallelBody(){;}
+    virtual void operator()(int begin,int end) = 0; //iterations [begin,end)
+  };
+  //===========================================================================
+  /**
+     Runs [begin,end) on the shared ThreadPool, using at most as many
+     threads, the caller included, as the caller's ThreadBudget allows.
+     Without WITH_THREAD_POOL the loop is run with OpenMP when the
+     library is built with it, and serially otherwise.
+  */
+  void ParallelFor(int begin,int end,ParallelBody &body);
+  //===========================================================================
+  /**
+     Limits the threads used by the ParallelFor calls made from this
+     thread for as long as it is in scope. Budgets nest, the smaller one
+     winning, and 0 leaves the enclosing budget as it is. Loops started
+     on the pool's workers run serially.
+  */
+  class ThreadBudget{
+  public:
+    ThreadBudget(int n); //maximum number of threads, 0 for no limit
+    ~ThreadBudget();
+    static int Current(); //budget of this thread, 0 for no limit
+  private:
+    int prev_;
+  };
+  //===========================================================================
+  /**
+     A fixed set of worker threads shared by all trackers of a process.
+     The iterations of a loop are split into one range per thread taking
+     part, each thread works through its own range and then steals half
+     of the largest range left, so threads finishing early help the 
+     others. The calling thread always takes part, so a loop completes 
+     even when every worker is busy with other loops.
+  */
+  class ThreadPool{
+  public:
+    static ThreadPool& Shared(); //one less worker than processors by default
+    void Resize(int n);          //number of workers, 0 runs loops serially
+    int Size();                  //number of workers
+    void Run(int begin,int end,ParallelBody &body,
+	     int nthreads);      //threads to use, caller included
+  private:
+    struct Part{int lo,hi;};
+    struct Job{
+      ParallelBody* body; std::vector<Part> part;
+      int grain,slots,next,running; //slots are parts no thread took yet
+      pthread_mutex_t lock; pthread_cond_t done;
+    };
+    std::vector<pthread_t> thread_; std::deque<Job*> queue_;
+    pthread_mutex_t lock_; pthread_cond_t cond_; bool quit_;
+
+    ThreadPool(); //never destroyed, the workers idle until exit
+    static void Create();
+    void Stop();
+    void Work(Job* job,int p);
+    static void* Main(void* self);
+    ThreadPool(ThreadPool const&);
+    ThreadPool& operator=(ThreadPool const&);
+  };
+  //===========================================================================
+}
+#endif
@@ -0,0 +1,84 @@
+// CSIRO has filed various patents which cover the Software. 
+
+// CSIRO grants to you a license to any patents granted for inventions
+// implemented by the Software for academic, research and non-commercial
+// use only.
+
+// CSIRO hereby reserves all rights to its inventions implemented by the
+// Software and any patents subsequently granted for those inventions
+// that are not expressly granted to you.  Should you wish to license the
+// patents relating to the Software for commercial use please contact
+// CSIRO IP & Licensing, Gautam Tendulkar (gautam.tendulkar@csiro.au) or
+// Nick Marsh (nick.marsh@csiro.au)
+
+// This software is provided under the CSIRO OPEN SOURCE LICENSE
+// (GPL2) which can be found in the LICENSE file located in the top
+// most directory of the source code.
+
+// Copyright CSIRO 2013
+
+#include <tracker/TrackerModel.hpp>
+using namespace FACETRACKER;
+using namespace std;
+//==============================================================================
+TrackerModel::TrackerModel(const char* fname)
+{
+  FaceTracker* model = LoadFaceTracker(fname);
+  _tracker = dynamic_cast<myFaceTracker*>(model);
+  if(_tracker == NULL){
+    printf("ERROR(%s,%d) : %s is not a myFaceTracker model\n",
+	   __FILE__,__LINE__,fname); abort();
+  }
+}
+//==============================================================================
+TrackerModel::~TrackerModel()
+{
+  delete _tracker;
+}
+//==============================================================================
+cv::Rect 
+TrackerModel::Detect(cv::Mat &im)
+{
+  cv::AutoLock lock(lock_); return _tracker->_sinit.Detect(im);
+}
+//==============================================================================
+vector<cv::Rect> 
+TrackerModel::DetectAll(cv::Mat &im)
+{
+  cv::AutoLock lock(lock_); return _tracker->_sinit.DetectAll(im);
+}
+//==============================================================================
+void 
+TrackerModel::Detect(cv::Mat &im,vector<FaceCandidate> &faces)
+{
+  cv::AutoLock lock(lock_); _tracker->_sinit.Detect(im,faces);
+}
+//==============================================================================
+//the detector of a shared model, which serialises the calls to it
+class ModelDetector : public FaceDetector{
+public:
+  ModelDetector(cv::Ptr<TrackerModel> model){model_ = model;}
+  void Detect(cv::Mat &im,vector<FaceCandidate> &faces)
+  {model_->Detect(im,faces); return;}
+private:
+  cv::Ptr<TrackerModel> model_;
+};
+//==============================================================================
+TrackerSession::TrackerSession(cv::Ptr<TrackerModel> model)
+{
+  _model = model; this->Share(*_model->_tracker);
+  _sinit._detector = cv::Ptr<FaceDetector>(new ModelDetector(_model));
+}
+//==============================================================================
+cv::Ptr<TrackerModel> 
+FACETRACKER::LoadTrackerModel(const char* fname)
+{
+  return cv::Ptr<TrackerModel>(new TrackerModel(fname));
+}
+//==============================================================================
+cv::Ptr<TrackerModel> 
+FACETRACKER::LoadTrackerModel()
+{
+  return LoadTrackerModel(DefaultFaceTrackerModelPathname().c_str());
+}
+//==============================================================================
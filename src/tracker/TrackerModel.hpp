@@ -0,0 +1,67 @@
+// CSIRO has filed various patents which cover the Software. 
+
+// CSIRO grants to you a license to any patents granted for inventions
+// implemented by the Software for academic, research and non-commercial
+// use only.
+
+// CSIRO hereby reserves all rights to its inventions implemented by the
+// Software and any patents subsequently granted for those inventions
+// that are not expressly granted to you.  Should you wish to license the
+// patents relating to the Software for commercial use please contact
+// CSIRO IP & Licensing, Gautam Tendulkar (gautam.tendulkar@csiro.au) or
+// Nick Marsh (nick.marsh@csiro.au)
+
+// This software is provided under the CSIRO OPEN SOURCE LICENSE
+// (GPL2) which can be found in the LICENSE file located in the top
+// most directory of the source code.
+
+// Copyright CSIRO 2013
+
+#ifndef _TRACKER_TrackerModel_h_
+#define _TRACKER_TrackerModel_h_
+#include <tracker/myFaceTracker.hpp>
+namespace FACETRACKER
+{
+  //============================================================================
+  /**
+     An immutable face tracker model. It is loaded once and shared, through a
+     cv::Ptr, by any number of TrackerSession objects which may run in
+     different threads. Only the face detector keeps scratch memory, so calls
+     to it are serialised.
+  */
+  class TrackerModel{
+  public:
+    myFaceTracker* _tracker; /**< Loaded models, never used for fitting */
+
+    TrackerModel(const char* fname); //file containing facetracker model
+    ~TrackerModel();
+
+    cv::Rect Detect(cv::Mat &im);               //largest face in image
+    std::vector<cv::Rect> DetectAll(cv::Mat &im); //all faces in image
+    void Detect(cv::Mat &im,std::vector<FaceCandidate> &faces); //scored
+  private:
+    cv::Mutex lock_;
+    TrackerModel(TrackerModel const&);
+    TrackerModel& operator=(TrackerModel const&);
+  };
+  //============================================================================
+  /**
+     Per-stream tracking state on top of a shared TrackerModel. It only owns
+     the fitting state and scratch memory, so creating one does not read the
+     model file. Faces are detected with the model's shared detector.
+  */
+  class TrackerSession : public myFaceTracker{
+  public:
+    cv::Ptr<TrackerModel> _model; /**< Shared model */
+
+    TrackerSession(cv::Ptr<TrackerModel> model);
+  };
+  //============================================================================
+  cv::Ptr<TrackerModel> 
+  LoadTrackerModel(const char* fname); //file containing facetracker model
+  
+  cv::Ptr<TrackerModel> 
+  LoadTrackerModel(); //load the default face tracker model
+  //============================================================================
+}
+#endif
@@ -113,6 +113,18 @@ PAW& PAW::operator= (PAW const& rhs)
   _dst = _src; return *this;
 }
 //===========================================================================
+void PAW::Share(PAW const& rhs)
+{   
+  _w = rhs._w; _h = rhs._h; _nPix = rhs._nPix; 
+  _xmin = rhs._xmin; _ymin = rhs._ymin;
+  _src = rhs._src; _tri = rhs._tri; _tridx = rhs._tridx; _mask = rhs._mask;
+  _alpha = rhs._alpha; _beta = rhs._beta;
+  _mapx.create(_mask.rows,_mask.cols,CV_32F);
+  _mapy.create(_mask.rows,_mask.cols,CV_32F);
+  _coeff.create(this->nTri(),6,CV_64F);
+  _dst = _src; return;
+}
+//===========================================================================
 void PAW::Write(ofstream &s, bool binary)
 {
   if(!binary){
@@ -133,7 +145,7 @@ void PAW::Write(ofstream &s, bool binary)
   return;
 }
 //===========================================================================
-void PAW::ReadBinary(ifstream &s,bool readType)
+void PAW::ReadBinary(istream &s,bool readType)
 {
  
   if(readType){int type; 
@@ -258,12 +270,41 @@ void PAW::Init(cv::Mat &src,cv::Mat &tri,cv::Mat &mask)
   return;
 }
 //=============================================================================
+//bilinear cv::remap of a CV_8U image with a zero border, using the same
+//1/32 pixel fixed point arithmetic but without its per call buffers
+static void RemapUchar(cv::Mat &src,cv::Mat &dst,cv::Mat &mapx,cv::Mat &mapy)
+{
+  if((dst.rows != mapx.rows) || (dst.cols != mapx.cols) || 
+     (dst.type() != CV_8U))dst.create(mapx.rows,mapx.cols,CV_8U);
+  for(int y = 0; y < dst.rows; y++){
+    const float* xp = mapx.ptr<float>(y); const float* yp = mapy.ptr<float>(y);
+    uchar* dp = dst.ptr<uchar>(y);
+    for(int x = 0; x < dst.cols; x++){
+      int X = cvRound(xp[x]*32),Y = cvRound(yp[x]*32);
+      int ix = X >> 5,iy = Y >> 5,a = X & 31,b = Y & 31,v[4] = {0,0,0,0};
+      if((ix >= src.cols) || (ix+1 < 0) || (iy >= src.rows) || (iy+1 < 0)){
+	dp[x] = 0; continue;
+      }
+      for(int k = 0; k < 4; k++){
+	int u = ix + (k&1),w = iy + (k>>1);
+	if((u >= 0) && (u < src.cols) && (w >= 0) && (w < src.rows))
+	  v[k] = src.ptr<uchar>(w)[u];
+      }
+      int sum = ((32-a)*(32-b)*v[0] + a*(32-b)*v[1] + 
+		 (32-a)*b*v[2] + a*b*v[3])*32;
+      dp[x] = cv::saturate_cast<uchar>((sum + (1 << 14)) >> 15);
+    }
+  }return;
+}
+//=============================================================================
 void PAW::Crop(cv::Mat &src, cv::Mat &dst, cv::Mat &s)
 {
   assert((s.type() == CV_64F) && (s.rows == _src.rows) && (s.cols == 1) && 
 	 (src.type() == dst.type()));
   this->SetDst(s); this->CalcCoeff(); this->WarpRegion(_mapx,_mapy);
-  cv::remap(src,dst,_mapx,_mapy,CV_INTER_LINEAR); return;
+  if(src.type() == CV_8U)RemapUchar(src,dst,_mapx,_mapy);
+  else cv::remap(src,dst,_mapx,_mapy,CV_INTER_LINEAR); 
+  return;
 }
 //=============================================================================
 void PAW::Vectorize(cv::Mat &img,cv::Mat &vec)
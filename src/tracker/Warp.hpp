@@ -67,11 +67,12 @@ namespace FACETRACKER
     virtual void SetDst(cv::Mat &dst){
       int n = _src.rows/2; 
       assert((dst.rows == 2*n) && (dst.cols == 1) && (dst.type() == CV_64F)); 
-      _dst = dst.clone(); return;
+      if(_dst.data == _src.data)_dst.release(); //never write over _src
+      dst.copyTo(_dst); return;
     }
     virtual void Write(std::ofstream &s, bool binary = false) = 0;
     virtual void Read(std::ifstream &s,bool readType = true) = 0;
-    virtual void ReadBinary(std::ifstream &s,bool readType = true) = 0;
+    virtual void ReadBinary(std::istream &s,bool readType = true) = 0;
     virtual void CalcCoeff() = 0;
     virtual void WarpPoint(double xi,double yi, double &xo, double &yo) = 0;
     virtual void WarpRegion(cv::Mat &mapx,cv::Mat &mapy) = 0;
@@ -103,12 +104,13 @@ namespace FACETRACKER
       _type = IO::PAW; this->Init(src,tri,mask);
     }
     PAW& operator=(PAW const&rhs);
+    void Share(PAW const&rhs); /**< share triangulation, own warp maps */
     inline int nTri(){return _tri.rows;}
 
     int nPix(){return _nPix;}
     void Write(std::ofstream &s, bool binary = false);
     void Read(std::ifstream &s,bool readType = true);
-    void ReadBinary(std::ifstream &s,bool readType = true);
+    void ReadBinary(std::istream &s,bool readType = true);
    void CalcCoeff();
     void WarpPoint(double xi,double yi, double &xo, double &yo);
     void WarpPoint(double xi, double yi, double &xo, double &yo, int t);
@@ -31,6 +31,7 @@ struct myTrackData1{
 };
 struct myTrackData2{
   bool calculate; cv::Mat mu,cov,covi,img; myFaceTracker* tracker; double gamma;
+  cv::Mat C,r; //scratch for covi*dxdp and covi*(mu-s)
 };
 //==============================================================================
 void 
@@ -79,9 +80,28 @@ myTrackFunc2(cv::Mat &/*im*/,   //image containing object
   d->tracker->_atm.BuildLinearSystem(d->img,s,dxdp,pose,H,g);   
   //  if(d->calculate){d->tracker->_ksmooth.Predict(im,s,d->mu,d->cov,d->covi);}
   if(d->mu.rows > 0){
+    int i,j,k,n = dxdp.rows,m = dxdp.cols; double w = 1.0-d->gamma;
     H *= d->gamma; g *= d->gamma;
-    H += (1.0-d->gamma)*dxdp.t()*d->covi*dxdp;
-    g += (1.0-d->gamma)*dxdp.t()*d->covi*(d->mu - s); 
+    for(i = 0; i < n; i++){
+      const double* c = d->covi.ptr<double>(i); double* Ci = d->C.ptr<double>(i);
+      double ri = 0; for(k = 0; k < m; k++)Ci[k] = 0;
+      for(j = 0; j < n; j++){
+	if(c[j] == 0)continue;
+	const double* Jj = dxdp.ptr<double>(j);
+	for(k = 0; k < m; k++)Ci[k] += c[j]*Jj[k];
+	ri += c[j]*(d->mu.db(j,0) - s.db(j,0));
+      }
+      d->r.db(i,0) = ri;
+    }
+    for(i = 0; i < n; i++){ //H += w*dxdp'*C
+      const double* Ji = dxdp.ptr<double>(i); const double* Ci = d->C.ptr<double>(i);
+      for(j = 0; j < m; j++){
+	if(Ji[j] == 0)continue;
+	double v = w*Ji[j],*Hj = H.ptr<double>(j);
+	for(k = 0; k < m; k++)Hj[k] += v*Ci[k];
+      }
+    }
+    AddJtr(dxdp,d->r,w,g);
   }
   d->calculate = false; return;
 }
@@ -109,6 +129,19 @@ myFaceTrackerParams::myFaceTrackerParams()
   track_type = 0;
   shape_predict = false;
   check_health = true;
+  redetect_radius = 0.5;
+  redetect_thresh = 0.5;
+  async_init = false;
+  precision = CV_64F;
+  pdm_itol = 10;
+  pdm_ftol = 1.0e-5;
+  work_face_width = 0;
+  motion_damping = 0;
+  motion_local = false;
+  key_interval = 1;
+  flow_error = 10;
+  flow_motion = 0.05;
+  threads = 0;
   
   atm_tri = cv::Mat();
   atm_scale = 0.25;
@@ -316,6 +349,19 @@ void myFaceTrackerParams::Load(const char* fname, bool binary)
 
   file.close();
   check_health = true;
+  redetect_radius = 0.5;
+  redetect_thresh = 0.5;
+  async_init = false;
+  precision = CV_64F;
+  pdm_itol = 10;
+  pdm_ftol = 1.0e-5;
+  work_face_width = 0;
+  motion_damping = 0;
+  motion_local = false;
+  key_interval = 1;
+  flow_error = 10;
+  flow_motion = 0.05;
+  threads = 0;
 
   if(init_type!=0){
     // std::cout << "init type changed to 0: " << init_type << std::endl;
@@ -340,13 +386,31 @@ myFaceTracker::myFaceTracker(const char* clmFile,
   _sinit.Load(sInitFile, binary);
   _fcheck.Load(FcheckFile, binary);
   _spred.Load(predFile, binary);
-  _time = -1;
+  _time = -1; fit3d_ = false; k_ = 1; nflow_ = 0; health_ = 0;
 }
 //=============================================================================
 void 
 myFaceTracker::Reset()
 {
-  _time = -1; _atm._init = false;
+  _time = -1; _atm._init = false; k_ = 1; det_.Cancel();
+}
+//=============================================================================
+void 
+myFaceTracker::Share(myFaceTracker const &rhs)
+{
+  _clm.Share(rhs._clm); _sinit.Share(rhs._sinit); 
+  _fcheck.Share(rhs._fcheck); _spred.Share(rhs._spred);
+  map_ = rhs.map_; this->Reset(); 
+  int n = _clm._pdm.nPoints();
+  mu_.create(2*n,1,CV_64F); cov_.create(2*n,2*n,CV_64F); 
+  covi_.create(2*n,2*n,CV_64F); return;
+}
+//=============================================================================
+void
+myFaceTracker::SetPrecision(int type)
+{
+  _clm.SetPrecision(type); _fcheck.SetPrecision(type); 
+  _spred.SetPrecision(type); return;
 }
 //=============================================================================
 std::vector<cv::Point_<double> >
@@ -371,7 +435,8 @@ myFaceTracker::get3DShape() const
   const int n = _shape.rows / 2;
   std::vector<cv::Point3_<double> > rv(n);
 
-  cv::Mat shape_3d = _clm._pdm.currentShape3D();  
+  this->Fit3D();
+  cv::Mat shape_3d = fit3d_ ? shape3d_ : _clm._pdm.currentShape3D();  
 
   if ((_shape.rows > 0) && ((_shape.rows % 2) == 0) && (_shape.cols == 1)) {
     assert((shape_3d.rows % 3) == 0);
@@ -390,57 +455,273 @@ Pose
 myFaceTracker::getPose() const
 {
   Pose rv;
-  rv.pitch = _clm._pglobl.db(1,0);
-  rv.yaw = _clm._pglobl.db(2,0);
-  rv.roll = _clm._pglobl.db(3,0);
+  this->Fit3D();
+  const cv::Mat &pglobl = fit3d_ ? pglobl3d_ : _clm._pglobl;
+  rv.pitch = pglobl.db(1,0);
+  rv.yaw = pglobl.db(2,0);
+  rv.roll = pglobl.db(3,0);
   return rv;
 }
 //=============================================================================
+void
+myFaceTracker::Fit3D() const
+{
+  //the fit runs on pdm3d_, which shares _clm's model and has its own
+  //scratch memory, so only the cached results are written
+  cv::AutoLock lock(fit3d_lock_);
+  if (fit3d_ || (_shape.rows != 2*_clm._pdm._n) || (_shape.cols != 1)) 
+    return;
+  pdm3d_.Share(_clm._pdm); //headers only, the model may have been reloaded
+  cv::Mat s = _shape; _clm._plocal.copyTo(plocal3d_); //the tracker's fit
+  pdm3d_.CalcParams(s,plocal3d_,pglobl3d_,pdm_itol_,pdm_ftol_);
+  pdm3d_.currentShape3D().copyTo(shape3d_);
+  fit3d_ = true; return;
+}
+//=============================================================================
+cv::Rect
+myFaceTracker::Detect(cv::Mat &im)
+{
+  return _sinit.Detect(im);
+}
+//=============================================================================
+//run on the detector's helper thread, so it must not call virtual methods
+//of a tracker that may be in its destructor
+static cv::Rect 
+AsyncDetect(cv::Mat &im,void* data)
+{
+  return static_cast<myFaceTracker*>(data)->Detect(im);
+}
+//=============================================================================
+//true if each rectangle contains the centre of the other
+static bool 
+Coincide(cv::Rect &a,cv::Rect &b)
+{
+  cv::Point ca(a.x+a.width/2,a.y+a.height/2),cb(b.x+b.width/2,b.y+b.height/2);
+  return a.contains(cb) && b.contains(ca);
+}
+//=============================================================================
+static cv::Rect
+ScaleRect(cv::Rect r,double s)
+{
+  return cv::Rect(cvRound(r.x*s),cvRound(r.y*s),
+		  cvRound(r.width*s),cvRound(r.height*s));
+}
+//=============================================================================
+//frame decimation that brings a face of this width (in input pixels)
+//down to about work_face_width
+static int
+Decimation(double width,myFaceTrackerParams* p)
+{
+  if (p->work_face_width <= 0) return 1;
+  return std::max(1,int(width/p->work_face_width));
+}
+//=============================================================================
+void
+myFaceTracker::PrepareFrame(cv::Mat &im,bool full,double margin)
+{
+  int w = im.cols/k_,h = im.rows/k_;
+  if ((k_ > 1) && ((work_.rows != h) || (work_.cols != w))) {
+    work_.create(h,w,CV_8U); full = true;
+  }
+  if ((im.channels() != 1) && 
+      ((full_.rows != im.rows) || (full_.cols != im.cols))) {
+    full_.create(im.rows,im.cols,CV_8U); full = true;
+  }
+  //while tracking only the area the next steps read is converted and
+  //decimated, each working pixel being the mean of a k_ x k_ input block
+  cv::Rect W(0,0,w,h),R = W;
+  if (!full) {
+    //ReDetect searches about the template moved by its last motion
+    cv::Point2d v = _sinit.Motion();
+    int mx = margin*rect_.width + std::ceil(std::fabs(v.x));
+    int my = margin*rect_.height + std::ceil(std::fabs(v.y));
+    R = cv::Rect(rect_.x-mx,rect_.y-my,rect_.width+2*mx,rect_.height+2*my);
+    R &= W; if ((R.width <= 0) || (R.height <= 0)) R = W;
+  }
+  roi_ = R; whole_ = (R == W);
+  cv::Rect S(R.x*k_,R.y*k_,R.width*k_,R.height*k_); cv::Mat src = im;
+  if (im.channels() != 1) {
+    cv::Mat dst = full_(S); cv::cvtColor(im(S),dst,CV_BGR2GRAY); src = full_;
+  }
+  if (k_ == 1) gray_ = src;
+  else {
+    cv::Mat dst = work_(R);
+    cv::resize(src(S),dst,dst.size(),0,0,cv::INTER_AREA);
+    gray_ = work_; 
+  }
+  pyr_.Reset(gray_,roi_); return;
+}
+//=============================================================================
+void
+myFaceTracker::PublishShape()
+{
+  if ((_shape.rows != wshape_.rows) || (_shape.cols != 1))
+    _shape.create(wshape_.rows,1,CV_64F);
+  if (k_ == 1) {wshape_.copyTo(_shape); return;}
+  for (int i = 0; i < wshape_.rows; i++)
+    _shape.db(i,0) = (wshape_.db(i,0) + 0.5)*k_ - 0.5;
+  return;
+}
+//=============================================================================
+bool
+myFaceTracker::Flow(myFaceTrackerParams* p)
+{
+  int n = wshape_.rows/2;
+  if ((prev_.rows != gray_.rows) || (prev_.cols != gray_.cols) || 
+      (int(pts0_.size()) != n) || (n == 0))
+    return false;
+
+  //only the region current in both frames is read
+  cv::Rect R = roi_ & proi_;
+  if ((R.width <= 0) || (R.height <= 0)) return false;
+  cv::Point2f o(R.x,R.y); int i;
+  for (i = 0; i < n; i++) pts0_[i] -= o;
+  cv::calcOpticalFlowPyrLK(prev_(R),gray_(R),pts0_,pts1_,status_,err_);
+  for (i = 0; i < n; i++) {pts0_[i] += o; pts1_[i] += o;}
+
+  //fall back to a full fit on poorly tracked or fast moving landmarks
+  double e = 0,d = 0;
+  for (i = 0; i < n; i++) {
+    if (!status_[i]) return false;
+    double dx = pts1_[i].x - pts0_[i].x,dy = pts1_[i].y - pts0_[i].y;
+    e += err_[i]; d = std::max(d,dx*dx + dy*dy);
+  }
+  double m = p->flow_motion*rect_.width;
+  if ((e/n > p->flow_error) || (d > m*m)) return false;
+
+  //the nearest shape the model can make
+  for (i = 0; i < n; i++) {
+    wshape_.db(i,0) = pts1_[i].x; wshape_.db(i+n,0) = pts1_[i].y;
+  }
+  PROFILE_STAGE(&_profiler,CALCPARAMS);
+  _clm._pdm.CalcParams(wshape_,_clm._plocal,_clm._pglobl,
+		       p->pdm_itol,p->pdm_ftol);
+  _clm._pdm.CalcShape2D(wshape_,_clm._plocal,_clm._pglobl);
+  return true;
+}
+//=============================================================================
+int
+myFaceTracker::NewFrame(cv::Mat &im,
+			FaceTrackerParams * params)
+{
+  return this->NewFrame(im,cv::Rect(0,0,0,0),params);
+}
+//=============================================================================
 int
 myFaceTracker::NewFrame(cv::Mat &im,
+			cv::Rect face,
 			FaceTrackerParams * params)
 {
   //set parameters
+  static myFaceTrackerParams defaults; //read only, shared by all trackers
   myFaceTrackerParams* p = 0;
-  bool release=false;
   if (params != NULL){
     p = dynamic_cast<myFaceTrackerParams *>(params);
   }
   
-  if (!p) {
-    p = new myFaceTrackerParams();
-    release=true;
-  }
+  if (!p)
+    p = &defaults;
+  fit3d_ = false; pdm_itol_ = p->pdm_itol; pdm_ftol_ = p->pdm_ftol;
+  ThreadBudget budget(p->threads);
+  if (p->precision != _clm.Precision())
+    this->SetPrecision(p->precision);
   
-  //convert image to greyscale
-  if(im.channels() == 1)gray_ = im;
-  else{
-    if((gray_.rows != im.rows) || (gray_.cols != im.cols))
-      gray_.create(im.rows,im.cols,CV_8U);
-    cv::cvtColor(im,gray_,CV_BGR2GRAY);
+  //convert to greyscale at the working resolution, all of the frame
+  //when detecting and the face's surroundings while tracking
+  bool face_given = (face.width > 0) && (face.height > 0);
+  if (face_given) {
+    int k = Decimation(face.width,p);
+    if (k != k_) {k_ = k; det_.Cancel();}
+    face = ScaleRect(face,1.0/k_);
+  } else if ((_time < 0) && (k_ != 1)) {
+    k_ = 1; det_.Cancel(); //search for faces of any size at full resolution
   }
+  //the clock is read once, so the frame is prepared in full exactly when
+  //the scheduled detection below is submitted
+  int64 now = cvGetTickCount();
+  bool due = (p->timeDet > 0) &&
+    (now - tdet_ >= p->timeDet*cv::getTickFrequency());
+  bool tracking = (_time >= 0) && !face_given && (p->redetect_radius > 0) &&
+    !due;
+  this->PrepareFrame(im,!tracking,p->redetect_radius + 0.5);
   
   //re-initialise and fit
-  bool gen=false; 
+  _clm._profiler = &_profiler; _atm._frame = &pyr_;
+  bool gen=false,flow=false; 
   bool rsize=true;
   cv::Rect R;  
-  if (_time < 0) {
-    R = _sinit.Detect(gray_); 
+  if ((face.width > 0) && (face.height > 0)) {
+    R = face;
+    _time = cvGetTickCount();
+    gen = true;
+  } else if ((_time < 0) && p->async_init) {
+    //use the last finished detection, or start one and report failure
+    int state = det_.Poll(R);
+    if ((state != AsyncDetector::DONE) || (R.width <= 0) || (R.height <= 0)) {
+      if (state != AsyncDetector::BUSY)
+	det_.Submit(gray_,&AsyncDetect,this);
+      return FaceTracker::TRACKER_FAILED;
+    }
+    _time = cvGetTickCount();
+    gen = true;
+  } else if (_time < 0) {
+    //the helper thread may be using the detector, so use its result
+    //rather than wait for it
+    int state = det_.Poll(R);
+    if (state == AsyncDetector::BUSY) return FaceTracker::TRACKER_FAILED;
+    if ((state != AsyncDetector::DONE) || (R.width <= 0) || (R.height <= 0)) {
+      PROFILE_STAGE(&_profiler,DETECT);
+      R = this->Detect(gray_); 
+    }
     if ((R.width <= 0) || (R.height <= 0)) {
       _time = -1;
-      if(release)
-	delete p;
       return FaceTracker::TRACKER_FAILED;
     }
     _time = cvGetTickCount();
     gen = true;
   } else {
-    R = _sinit.ReDetect(gray_);
     gen = false;
+    if (p->timeDet > 0) {
+      //re-seed from the scheduled detection when it disagrees with the track
+      cv::Rect D;
+      if ((det_.Poll(D) == AsyncDetector::DONE) && 
+	  (D.width > 0) && (D.height > 0) && !Coincide(D,rect_)) {
+	R = D; _time = now; gen = true;
+      } else if (due && det_.Submit(gray_,&AsyncDetect,this)) {
+	tdet_ = now;
+      }
+    }
+    if (!gen && (nflow_ + 1 < p->key_interval)) {
+      PROFILE_STAGE(&_profiler,FLOW);
+      flow = this->Flow(p); rsize = false;
+    }
+    if (!gen && !flow) {
+      PROFILE_STAGE(&_profiler,REDETECT);
+      R = _sinit.ReDetect(pyr_,p->redetect_radius,p->redetect_thresh,whole_);
+      if ((R.width <= 0) || (R.height <= 0)) {
+	this->PrepareFrame(im,true,0); 
+	R = _sinit.ReDetect(pyr_,0,p->redetect_thresh);
+      }
+    }
   }
+  if (gen) 
+    tdet_ = _time;
+  if (gen && !face_given) {
+    //choose the working resolution for the detected face
+    int k = Decimation(R.width*k_,p);
+    if (k != k_) {
+      R = ScaleRect(R,double(k_)/k); k_ = k; det_.Cancel(); whole_ = false;
+    }
+  }
+  if (gen && !whole_)
+    this->PrepareFrame(im,true,0); //a detection may be anywhere in the frame
   if(gen){
-    _sinit.InitShape(gray_,_shape,R);
-    _clm._pdm.CalcParams(_shape,_clm._plocal,_clm._pglobl);     
+    motion_.Reset();
+    _sinit.InitShape(gray_,wshape_,R);
+    {
+      PROFILE_STAGE(&_profiler,CALCPARAMS);
+      _clm._pdm.CalcParams(wshape_,_clm._plocal,_clm._pglobl);     
+    }
     if(p->init_type == 0)
       _clm.Fit(gray_,p->init_wSize,p->itol,p->clamp,p->ftol);
     else{
@@ -452,25 +733,22 @@ myFaceTracker::NewFrame(cv::Mat &im,
     //   _clm.FitPrior(gray_,p->init_wSize,p->itol,p->clamp,p->ftol,p->init_lambda,
     // 		    myInitFunc,&data);
     // }
-  }else{
+  }else if(!flow){
+    motion_.Predict(_clm._plocal,_clm._pglobl,p->motion_damping,
+		    p->motion_local);
     double tx = R.x - rect_.x,ty = R.y - rect_.y;
     _clm._pglobl.db(4,0) += tx; _clm._pglobl.db(5,0) += ty; 
-    int n = _shape.rows/2; 
-    cv::Mat sx = _shape(cv::Rect(0,0,1,n)),sy = _shape(cv::Rect(0,n,1,n));
+    int n = wshape_.rows/2; 
+    cv::Mat sx = wshape_(cv::Rect(0,0,1,n)),sy = wshape_(cv::Rect(0,n,1,n));
     sx += tx; sy += ty; rsize = false;
     if(p->track_type == 0)
       _clm.Fit(gray_,p->track_wSize,p->itol,p->clamp,p->ftol);
     else{
-      if(_atm._scale == 1)smooth_ = gray_;
-      else{
-	cv::Size ksize((1.0/_atm._scale)*3+1,(1.0/_atm._scale)*3+1);
-	cv::GaussianBlur(gray_,smooth_,ksize,0,0);
-      }
-      vector<cv::Mat> visi;
+      smooth_ = pyr_.Smooth(_atm._scale);
       if(p->visi.size() == _clm._visi.size()){
-	visi.resize(_clm._visi.size());
-	for(int i = 0; i < int(visi.size()); i++){
-	  visi[i] = _clm._visi[i].clone();
+	visi_.resize(_clm._visi.size());
+	for(int i = 0; i < int(visi_.size()); i++){
+	  _clm._visi[i].copyTo(visi_[i]);
 	  p->visi[i].copyTo(_clm._visi[i]);
 	}
       }
@@ -482,55 +760,81 @@ myFaceTracker::NewFrame(cv::Mat &im,
 	myTrackData2 data; data.img = smooth_; data.tracker = this;
 	data.cov = cov_; data.mu = mu_; data.covi = covi_; 
 	data.gamma = p->gamma; data.calculate = true; 
+	int n = 2*_clm._pdm.nPoints(),m = 6+_clm._pdm.nModes();
+	if((cj_.rows != n) || (cj_.cols != m))cj_.create(n,m,CV_64F);
+	if(cr_.rows != n)cr_.create(n,1,CV_64F);
+	data.C = cj_; data.r = cr_;
 	_clm.FitPrior(gray_,p->track_wSize,p->itol,p->clamp,p->ftol,
 		      p->track_lambda,myTrackFunc2,&data);
       }
       if(p->visi.size() == _clm._visi.size()){
-	for(int i = 0; i < int(visi.size()); i++)visi[i].copyTo(_clm._visi[i]);
+	for(int i = 0; i < int(visi_.size()); i++)visi_[i].copyTo(_clm._visi[i]);
       }
     }
   }
-  _clm._pdm.CalcShape2D(_shape,_clm._plocal,_clm._pglobl);
-  if(p->shape_predict){
-    _spred.Predict(_shape,gray_);
-    _clm._pdm.CalcParams(_shape,_clm._plocal,_clm._pglobl);
+  if(!flow)
+    _clm._pdm.CalcShape2D(wshape_,_clm._plocal,_clm._pglobl);
+  if(p->shape_predict && !flow){
+    {
+      PROFILE_STAGE(&_profiler,PREDICT);
+      _spred.Predict(wshape_,gray_);
+    }
+    PROFILE_STAGE(&_profiler,CALCPARAMS);
+    _clm._pdm.CalcParams(wshape_,_clm._plocal,_clm._pglobl,
+			 p->pdm_itol,p->pdm_ftol);
   }
+  this->PublishShape(); motion_.Update(_clm._plocal,_clm._pglobl);
   
   int health;
   if (p->check_health) {
-    int n = _shape.rows/2,i;
+    int n = wshape_.rows/2,i;
     for (i = 0; i < n; i++) {
-      if ((_shape.db(i  ,0) < 0) || (_shape.db(i  ,0) >= gray_.cols) ||
-	  (_shape.db(i+n,0) < 0) || (_shape.db(i+n,0) >= gray_.rows))
+      if ((wshape_.db(i  ,0) < 0) || (wshape_.db(i  ,0) >= gray_.cols) ||
+	  (wshape_.db(i+n,0) < 0) || (wshape_.db(i+n,0) >= gray_.rows))
 	break;
     }
     
     //report when not all points are within the frame
     if(i < n)
       health = FaceTracker::TRACKER_FACE_OUT_OF_FRAME;         
-    else
-      health = _fcheck.Check(gray_,_shape,_clm.GetViewIdx());
+    else if(flow)
+      health = health_; //only checked on keyframes
+    else {
+      PROFILE_STAGE(&_profiler,CHECK);
+      health = _fcheck.Check(gray_,wshape_,_clm.GetViewIdx());
+    }
   } else {
     health = 10;
   }
 
   if (health < 0) {
     _time = -1;
-    if (release) 
-      delete p;
     return health;
   }
 
   //update models
-  rect_ = _sinit.Update(gray_,_shape,rsize);
+  {
+    PROFILE_STAGE(&_profiler,UPDATE);
+    rect_ = _sinit.Update(pyr_,wshape_,rsize);
+  }
   if ((rect_.width == 0) || (rect_.height == 0)) {
     _time = -1;
-    if(release)
-      delete p;
     return FaceTracker::TRACKER_FAILED;
   }
 
-  if (p->track_type > 0) {
+  //keep this frame for the optical flow to the next
+  nflow_ = flow ? nflow_ + 1 : 0; health_ = health;
+  if (p->key_interval > 1) {
+    int n = wshape_.rows/2; pts0_.resize(n);
+    for (int i = 0; i < n; i++)
+      pts0_[i] = cv::Point2f(wshape_.db(i,0),wshape_.db(i+n,0));
+    if ((prev_.rows != gray_.rows) || (prev_.cols != gray_.cols))
+      prev_.create(gray_.rows,gray_.cols,CV_8U);
+    cv::Mat dst = prev_(roi_); gray_(roi_).copyTo(dst); proi_ = roi_;
+  }
+
+  if ((p->track_type > 0) && !flow) {
+    PROFILE_STAGE(&_profiler,ATM);
     if ((dxdp_.rows != 2*_clm._pdm.nPoints()) || 
 	(dxdp_.cols != 6+_clm._pdm.nModes())) {
       dxdp_.create(2*_clm._pdm.nPoints(),6+_clm._pdm.nModes(),CV_64F); 
@@ -540,34 +844,26 @@ myFaceTracker::NewFrame(cv::Mat &im,
 
     cv::Mat pose = _clm._pglobl(cv::Rect(0,1,1,3));
     if (!_atm._init) {
-      if (_atm._scale == 1) {
-	smooth_ = gray_;
-      } else {
-	cv::Size ksize((1.0/p->atm_scale)*3+1,(1.0/p->atm_scale)*3+1);
-	cv::GaussianBlur(gray_,smooth_,ksize,0,0);
-      }
-      _atm.Init(p->center,pose,_shape,smooth_,p->atm_tri,p->atm_scale);
-      _atm.Update(smooth_,_shape,dxdp_,pose,p->atm_ntemp,-1); 
+      smooth_ = pyr_.Smooth(p->atm_scale);
+      _atm.Init(p->center,pose,wshape_,smooth_,p->atm_tri,p->atm_scale);
+      _atm.Update(smooth_,wshape_,dxdp_,pose,p->atm_ntemp,-1); 
     } else {
-      _atm.Update(smooth_,_shape,dxdp_,pose,p->atm_ntemp,p->atm_thresh);
+      _atm.Update(smooth_,wshape_,dxdp_,pose,p->atm_ntemp,p->atm_thresh);
     }
 
     // if(_pra._pra.size() > 0){
     //   if(p->track_type > 1){
     // 	if(!_ksmooth._init)
-    // 	  _ksmooth.Init(_shape,_clm._pdm._M,p->center,p->ksmooth_size,
+    // 	  _ksmooth.Init(wshape_,_clm._pdm._M,p->center,p->ksmooth_size,
     // 			p->ksmooth_sigma,p->ksmooth_noise,p->ksmooth_thresh,
     // 			p->ksmooth_ntemp);
-    // 	_ksmooth.Update(gray_,_shape);
+    // 	_ksmooth.Update(gray_,wshape_);
     //   }
     // }
   }
 
-  // update the 3D shape
-  _clm._pdm.CalcParams(_shape,_clm._plocal,_clm._pglobl);  
-
-  if (release) 
-    delete p;
+  //the 3D shape and pose are fitted on first use, see Fit3D. The next
+  //frame starts from _clm's parameters, which already fit wshape_
 
   return health;
 }
@@ -589,7 +885,7 @@ myFaceTracker::Read(ifstream &s,
 }
 //=============================================================================
 void 
-myFaceTracker::ReadBinary(ifstream &s,
+myFaceTracker::ReadBinary(istream &s,
 			  bool readType)
 {
   if(readType){int type; 
@@ -609,6 +905,12 @@ myFaceTracker::ReadBinary(ifstream &s,
 }
 //=============================================================================
 void 
+myFaceTracker::LoadMapped(const char* fname)
+{
+  map_ = new MappedFile(fname); this->ReadBinary(map_->Stream()); return;
+}
+//=============================================================================
+void 
 myFaceTracker::Write(ofstream &s, bool binary)
 {
   if(!binary)
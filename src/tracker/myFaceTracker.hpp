@@ -26,8 +26,11 @@
 #include <tracker/RegistrationCheck.hpp>
 #include <tracker/FaceTracker.hpp>
 #include <tracker/ShapePredictor.hpp>
+#include <tracker/AsyncDetector.hpp>
+#include <tracker/MotionModel.hpp>
 namespace FACETRACKER
 {
+  class myFaceTrackerParams;
   //============================================================================
   class myFaceTracker : public FaceTracker{
   public:
@@ -38,8 +41,11 @@ namespace FACETRACKER
     mvRegistrationCheck _fcheck;   /**< Failure checker                     */
     ShapePredictorList _spred;     /**< Refining shape predictors           */
 
-    myFaceTracker(){_time=-1;}
-    myFaceTracker(const char* fname, bool binary = false){this->Load(fname, binary);}
+    myFaceTracker(){_time=-1; fit3d_=false; k_=1; nflow_=0; health_=0;}
+    myFaceTracker(const char* fname, bool binary = false){
+      fit3d_=false; k_=1; nflow_=0; health_=0; this->Load(fname, binary);
+    }
+    virtual ~myFaceTracker(){det_.Stop();}
     myFaceTracker(const char* clmFile,     //CLM
 		  const char* sInitFile,   //SInit
 		  const char* FcheckFile,  //RegistrationCheck
@@ -47,6 +53,10 @@ namespace FACETRACKER
 		  const char* predFile,   //ShapePredictor
 		  bool binary = false); // if the files are binary
     void Reset(); //reset tracker
+    void Share(myFaceTracker const &rhs); //share rhs's models, own state
+    void LoadMapped(const char* fname); //file saved with SaveMapped
+    void SetPrecision(int type); //CV_64F or CV_32F, see myFaceTrackerParams
+    cv::Rect Detect(cv::Mat &im); //largest face found by _sinit's detector
 
     std::vector<cv::Point_<double> > getShape() const;
     std::vector<cv::Point3_<double> > get3DShape() const;
@@ -55,11 +65,15 @@ namespace FACETRACKER
     int                          //-1 on failure, 0 otherwise
     NewFrame(cv::Mat &im,        //grayscale image to track
 	     FaceTrackerParams* params=NULL); //additinal parameters
+    int                          //-1 on failure, 0 otherwise
+    NewFrame(cv::Mat &im,        //grayscale image to track
+	     cv::Rect face,      //re-initialise from this box if non-empty
+	     FaceTrackerParams* params=NULL); //additinal parameters
     void 
     Read(std::ifstream &s,      //file stream to read from
 	 bool readType = true); //read type?
     void 
-    ReadBinary(std::ifstream &s,      //file stream to read from
+    ReadBinary(std::istream &s,      //file stream to read from
 	       bool readType = true); //read type?
 
     void 
@@ -69,16 +83,51 @@ namespace FACETRACKER
     const cv::Mat mu(){return mu_;}
     const cv::Mat cov(){return cov_;}
 
-    cv::Mat getShapeParameters(){return _clm._plocal.clone();}
-    cv::Mat getPoseParameters(){return _clm._pglobl.clone();}
+    cv::Mat getShapeParameters(){
+      this->Fit3D(); return (fit3d_ ? plocal3d_ : _clm._plocal).clone();
+    }
+    cv::Mat getPoseParameters(){
+      this->Fit3D(); return (fit3d_ ? pglobl3d_ : _clm._pglobl).clone();
+    }
   protected:
     cv::Rect rect_; cv::Mat gray_,mu_,cov_,covi_,smooth_,dxdp_;
+    cv::Mat cj_,cr_; std::vector<cv::Mat> visi_; //track_type > 0 scratch
+    AsyncDetector det_; int64 tdet_; //scheduled detection, see timeDet
+    cv::Ptr<MappedFile> map_; //backs the model matrices when memory mapped
+    int pdm_itol_; double pdm_ftol_; //see Fit3D
+    mutable bool fit3d_; mutable cv::Mutex fit3d_lock_; //cached 3D fit
+    mutable PDM3D pdm3d_; mutable cv::Mat plocal3d_,pglobl3d_,shape3d_;
+
+    void Fit3D() const; //3D fit to _shape, once per frame on first use
+    int k_; cv::Mat full_,work_,wshape_; //1/k_ scale working frame and shape
+    cv::Rect roi_; bool whole_; //part of gray_ that is current
+    FramePyramid pyr_; //scaled and filtered gray_, shared by the stages
+    MotionModel motion_; //seeds each fit from the last frames' motion
+    int nflow_,health_; //frames since the keyframe, its health
+    cv::Mat prev_; cv::Rect proi_; //keyframe, the part of it that is current
+    std::vector<cv::Point2f> pts0_,pts1_; std::vector<uchar> status_;
+    std::vector<float> err_; //optical flow of the landmarks, see Flow
+
+    void PrepareFrame(cv::Mat &im,bool full,double margin); //im to gray_
+    void PublishShape(); //wshape_ in input coordinates to _shape
+    bool Flow(myFaceTrackerParams* p); //move wshape_ by optical flow
   };
   //============================================================================
+  /**
+     Tracker settings. With track_type 0, timeDet <= 0 and key_interval 1,
+     a tracker following a face through frames of one size makes no heap
+     allocation once its buffers have been sized, on every frame where the
+     face is found inside the redetect_radius window and the decimation
+     chosen for work_face_width is unchanged. Face detection, the whole
+     frame re-detection search, the appearance models of track_type 1 and
+     2, the scheduled detections of timeDet > 0 and the optical flow of
+     key_interval > 1 all allocate. alloc_test checks this configuration.
+  */
   class myFaceTrackerParams : public FaceTrackerParams {
   public:
     int type;               /**< Type of object                           */
-    int timeDet;            /**< Time between detections (seconds)        */
+    int timeDet;            /**< Time between detections (seconds), <= 0 
+			       disables detection while tracking        */
     int itol;               /**< Maximum number of iterations             */
     double ftol;            /**< Convergence tolerance                    */
     double clamp;           /**< Shape model clamping factor              */
@@ -89,6 +138,32 @@ namespace FACETRACKER
     int track_type;         /**< 0=CLM only, 1=CLM+atm, 2=CLM+atm+ksmooth */
     bool shape_predict;     /**< Use shape predictor for refinement?      */
     bool check_health;      /**< Check health of tracker                 */
+    double redetect_radius; /**< Re-detection search radius (template
+			       sizes, see SInit::ReDetect)            */
+    double redetect_thresh; /**< Search whole frame below this NCC score  */
+    bool async_init;        /**< Detect faces on a helper thread while
+			       the tracker is not initialised          */
+    int precision;          /**< Working precision, CV_64F. CV_32F is
+			       experimental and its accuracy has not
+			       been measured, see precision_test      */
+    int pdm_itol;           /**< Maximum iterations of the warm started
+			       PDM3D::CalcParams while tracking         */
+    double pdm_ftol;        /**< Its convergence tolerance                */
+    double work_face_width; /**< Track at a decimated resolution where the
+			       face is about this wide (pixels), 0=off */
+    double motion_damping;  /**< Fraction of the last frame's change in
+			       scale and rotation predicted for the
+			       next, 0=off                             */
+    bool motion_local;      /**< Predict the local parameters too?      */
+    int key_interval;       /**< Fit fully every this many frames and
+			       follow the landmarks by optical flow in
+			       between, 1=fit every frame              */
+    double flow_error;      /**< Fit fully when the mean optical flow 
+			       error exceeds this (grey levels)        */
+    double flow_motion;     /**< or a landmark moves more than this
+			       (face widths)                           */
+    int threads;            /**< Threads of the shared pool used for a
+			       frame, caller included, 0=all           */
     std::vector<int> init_wSize; /**< CLM search window sizes             */
     std::vector<int> track_wSize; /**< CLM search window sizes            */
     std::vector<cv::Mat> center; /**< Center view poses                   */